@@ -205,6 +205,11 @@ extern const PinDescription g_APinDescription[] ;
 #include "wiring_analog.h"
 #include "wiring_shift.h"
 #include "WInterrupts.h"
+#include "wiring_dmac.h"
+#include "wiring_adc.h"
+#include "wiring_dac.h"
+#include "wiring_pwm.h"
+#include "wiring_capture.h"
 
 #include "watchdog.h"
 
@@ -57,6 +57,8 @@ static volatile LineInfo _usbLineInfo = {
 
 static volatile int32_t breakValue = -1;
 
+extern USBD_Stats _usbStats;
+
 _Pragma("pack(1)")
 static const CDCDescriptor _cdcInterface =
 {
@@ -204,6 +206,10 @@ void Serial_::accept(void)
 		i = (i + 1) % CDC_SERIAL_BUFFER_SIZE;
 	}
 
+	// Anything left waits in the fifo, the host is NAKed meanwhile
+	if (i == buffer->tail && USBD_Available(CDC_RX))
+		_usbStats.ep[CDC_RX].rxBufferFull++;
+
 	// release the guard
 	guard = 0;
 }
@@ -61,6 +61,25 @@ void PluggableUSB_::getShortName(char *iSerialNum)
 	*iSerialNum = 0;
 }
 
+void PluggableUSB_::handleSOF(uint32_t frameNumber)
+{
+	PluggableUSBModule* node;
+	for (node = rootNode; node; node = node->next) {
+		node->handleSOF(frameNumber);
+	}
+}
+
+bool PluggableUSB_::handleEndpoint(uint8_t ep)
+{
+	PluggableUSBModule* node;
+	for (node = rootNode; node; node = node->next) {
+		if (ep >= node->pluggedEndpoint && ep < node->pluggedEndpoint + node->numEndpoints) {
+			return node->handleEndpoint(ep);
+		}
+	}
+	return false;
+}
+
 bool PluggableUSB_::setup(USBSetup& setup)
 {
 	PluggableUSBModule* node;
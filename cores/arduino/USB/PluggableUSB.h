@@ -35,6 +35,12 @@ protected:
   virtual int getInterface(uint8_t* interfaceCount) = 0;
   virtual int getDescriptor(USBSetup& setup) = 0;
   virtual uint8_t getShortName(char *name) { name[0] = 'A'+pluggedInterface; return 1; }
+  // Called from the USB interrupt on every (micro)frame once USBD_EnableSOF()
+  // has been called; frameNumber is (frame << 3) | microframe
+  virtual void handleSOF(uint32_t frameNumber) { (void)frameNumber; }
+  // Called from the USB interrupt for endpoint interrupts the module
+  // enabled on one of its endpoints; returns false if it did not handle it
+  virtual bool handleEndpoint(uint8_t ep) { (void)ep; return false; }
 
   uint8_t pluggedInterface;
   uint8_t pluggedEndpoint;
@@ -56,6 +62,8 @@ public:
   int getDescriptor(USBSetup& setup);
   bool setup(USBSetup& setup);
   void getShortName(char *iSerialNum);
+  void handleSOF(uint32_t frameNumber);
+  bool handleEndpoint(uint8_t ep);
 
 private:
   uint8_t lastIf;
@@ -153,10 +153,57 @@ bool USBD_ClassInterfaceRequest(USBSetup& setup);
 uint32_t USBD_Available(uint32_t ep);
 uint32_t USBD_SendSpace(uint32_t ep);
 uint32_t USBD_Send(uint32_t ep, const void* d, uint32_t len);
+uint32_t USBD_SendPacket(uint32_t ep, const void* d, uint32_t len);	// non-blocking, one packet
 uint32_t USBD_Recv(uint32_t ep, void* data, uint32_t len);		// non-blocking
 uint32_t USBD_Recv(uint32_t ep);							// non-blocking
 void USBD_Flush(uint32_t ep);
 uint32_t USBD_Connected(void);
 
+//	Isochronous endpoints
+//	Each call fills or drains one bank of a double banked (ping-pong) endpoint
+uint32_t USBD_SendIso(uint32_t ep, const void* d, uint32_t len);	// non-blocking
+uint32_t USBD_RecvIso(uint32_t ep, void* d, uint32_t len);		// non-blocking
+void USBD_EnableSOF(bool microFrames);
+void USBD_DisableSOF(void);
+uint32_t USBD_GetMicroFrameNumber(void);
+bool USBD_IsHighSpeed(void);
+void USBD_EnableSendInterrupt(uint32_t ep);
+void USBD_DisableSendInterrupt(uint32_t ep);
+
+//	Statistics
+//	Counted at run time to tell whether throughput is limited by the host
+//	(sendWaits, time spent waiting for a free bank), by the copy loop or by
+//	the sketch not reading fast enough (rxBufferFull)
+typedef struct
+{
+	uint32_t packetsIn;			// device to host
+	uint32_t bytesIn;
+	uint32_t packetsOut;		// host to device
+	uint32_t bytesOut;
+	uint32_t sendWaits;			// USBD_Send() found no free bank
+	uint32_t sendWaitMicros;	// total time spent waiting for it
+	uint32_t rxBufferFull;		// packet held back in the fifo, receive buffer full
+} USBD_EndpointStats;
+
+typedef struct
+{
+	uint32_t resets;
+	uint32_t setups;
+	uint32_t stalls;
+	USBD_EndpointStats ep[USB_ENDPOINTS];
+} USBD_Stats;
+
+typedef struct
+{
+	uint16_t frame;
+	uint32_t bytes;
+} USBD_ThroughputSample;
+
+const USBD_Stats& USBD_GetStats(void);
+void USBD_ClearStats(void);
+//	Bytes per second moved on ep since the previous call with the same sample,
+//	timed by the host's frame counter. Call at least every two seconds.
+uint32_t USBD_SampleThroughput(uint32_t ep, USBD_ThroughputSample& sample);
+
 #endif
 #endif
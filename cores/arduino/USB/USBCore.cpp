@@ -111,6 +111,8 @@ volatile uint32_t _usbInitialized = 0;
 uint32_t _usbSetInterface = 0;
 uint32_t _cdcComposite = 0;
 
+USBD_Stats _usbStats;
+
 //==================================================================
 //==================================================================
 
@@ -128,6 +130,20 @@ public:
     }
 };
 
+//    Wait for a free bank on an IN endpoint, which only happens when the
+//    host does not poll as fast as we send
+static void USBD_WaitIN(uint32_t ep)
+{
+    if (Is_udd_in_send(ep))
+        return;
+
+    uint32_t start = micros();
+    while (!Is_udd_in_send(ep))
+        ;
+    _usbStats.ep[ep].sendWaits++;
+    _usbStats.ep[ep].sendWaitMicros += micros() - start;
+}
+
 //    Number of bytes, assumes a rx endpoint
 uint32_t USBD_Available(uint32_t ep)
 {
@@ -149,8 +165,12 @@ uint32_t USBD_Recv(uint32_t ep, void* d, uint32_t len)
     uint8_t* dst = (uint8_t*)d;
     while (n--)
         *dst++ = UDD_Recv8(ep & 0xF);
+    _usbStats.ep[ep & 0xF].bytesOut += len;
     if (len && !UDD_FifoByteCount(ep & 0xF)) // release empty buffer
+    {
         UDD_ReleaseRX(ep & 0xF);
+        _usbStats.ep[ep & 0xF].packetsOut++;
+    }
 
     return len;
 }
@@ -200,7 +220,10 @@ uint32_t USBD_Send(uint32_t ep, const void* d, uint32_t len)
             n = len;
         len -= n;
 
+        USBD_WaitIN(ep & 0xF);
         UDD_Send(ep & 0xF, data, n);
+        _usbStats.ep[ep & 0xF].packetsIn++;
+        _usbStats.ep[ep & 0xF].bytesIn += n;
         data += n;
     }
     //TXLED1;                    // light the TX LED
@@ -208,6 +231,117 @@ uint32_t USBD_Send(uint32_t ep, const void* d, uint32_t len)
     return r;
 }
 
+//    Non blocking send of one packet, for interrupt and isochronous endpoints
+//    Return number of bytes queued, -1 if no bank is free yet
+uint32_t USBD_SendPacket(uint32_t ep, const void* d, uint32_t len)
+{
+    if (!_usbConfiguration)
+        return -1;
+
+    ep &= 0xF;
+    LockEP lock(ep);
+    if (!Is_udd_in_send(ep))
+        return -1;
+
+    uint32_t n = udd_get_endpoint_size(ep);
+    len = min(n,len);
+    const uint8_t* src = (const uint8_t*)d;
+    volatile uint8_t* dst = (volatile uint8_t*)&udd_get_endpoint_fifo_access8(ep);
+    for (n = 0; n < len; n++)
+        *dst++ = *src++;
+
+    // Hand the bank over, the other one can be filled meanwhile
+    udd_ack_in_send(ep);
+    udd_ack_fifocon(ep);
+    _usbStats.ep[ep].packetsIn++;
+    _usbStats.ep[ep].bytesIn += len;
+    return len;
+}
+
+//    Non blocking send of one isochronous packet
+uint32_t USBD_SendIso(uint32_t ep, const void* d, uint32_t len)
+{
+    return USBD_SendPacket(ep, d, len);
+}
+
+//    Non blocking receive of one isochronous packet
+//    Bytes not fitting in data are dropped with the packet
+//    Return number of bytes read, -1 if no packet is pending
+uint32_t USBD_RecvIso(uint32_t ep, void* d, uint32_t len)
+{
+    if (!_usbConfiguration)
+        return -1;
+
+    ep &= 0xF;
+    LockEP lock(ep);
+    if (!Is_udd_out_received(ep))
+        return -1;
+
+    uint32_t n = udd_byte_count(ep);
+    len = min(n,len);
+    uint8_t* dst = (uint8_t*)d;
+    volatile uint8_t* src = (volatile uint8_t*)&udd_get_endpoint_fifo_access8(ep);
+    for (n = 0; n < len; n++)
+        *dst++ = *src++;
+
+    udd_ack_out_received(ep);
+    udd_ack_fifocon(ep);
+    _usbStats.ep[ep].packetsOut++;
+    _usbStats.ep[ep].bytesOut += len;
+    return len;
+}
+
+//    Start of frame interrupts are off by default, modules streaming
+//    on isochronous endpoints turn them on to pace their transfers
+void USBD_EnableSOF(bool microFrames)
+{
+    udd_ack_sof();
+    udd_enable_sof_interrupt();
+    if (microFrames)
+    {
+        udd_ack_msof();
+        udd_enable_msof_interrupt();
+    }
+    else
+    {
+        udd_disable_msof_interrupt();
+    }
+}
+
+void USBD_DisableSOF(void)
+{
+    udd_disable_sof_interrupt();
+    udd_disable_msof_interrupt();
+}
+
+//    (frame << 3) | microframe, microframe is always 0 at full speed
+uint32_t USBD_GetMicroFrameNumber(void)
+{
+    return udd_micro_frame_number();
+}
+
+bool USBD_IsHighSpeed(void)
+{
+    return Rd_bits(UOTGHS->UOTGHS_SR, UOTGHS_SR_SPEED_Msk) == UOTGHS_SR_SPEED_HIGH_SPEED;
+}
+
+//    Interrupt whenever a bank of the IN endpoint is free, delivered to
+//    PluggableUSBModule::handleEndpoint() until disabled again
+void USBD_EnableSendInterrupt(uint32_t ep)
+{
+    ep &= 0xF;
+    LockEP lock(ep);
+    udd_enable_in_send_interrupt(ep);
+    udd_enable_endpoint_interrupt(ep);
+}
+
+void USBD_DisableSendInterrupt(uint32_t ep)
+{
+    ep &= 0xF;
+    LockEP lock(ep);
+    udd_disable_in_send_interrupt(ep);
+}
+
 uint16_t _cmark;
 uint16_t _cend;
 
@@ -231,8 +365,10 @@ int USBD_SendControl(uint8_t flags __attribute__ ((unused)), const void* d, uint
     {
         while (len > 0)
         {
+            USBD_WaitIN(EP0);
             sent = UDD_Send(EP0, data + pos, len);
             TRACE_CORE(printf("=> USBD_SendControl sent=%lu\r\n", sent);)
+            _usbStats.ep[EP0].bytesIn += sent;
             pos += sent;
             len -= sent;
         }
@@ -272,6 +408,8 @@ int USBD_RecvControl(void* d, uint32_t len)
     UDD_WaitOUT();
     UDD_Recv(EP0, (uint8_t*)d, len);
     UDD_ClearOUT();
+    _usbStats.ep[EP0].packetsOut++;
+    _usbStats.ep[EP0].bytesOut += len;
 
     return len;
 }
@@ -616,6 +754,7 @@ static void USB_ISR(void)
         udd_enable_endpoint_interrupt(0);
 
         _usbConfiguration = 0;
+        _usbStats.resets++;
         udd_ack_reset();
     }
 
@@ -628,13 +767,38 @@ static void USB_ISR(void)
         if (USBD_Available(CDC_RX))
             SerialUSB.accept();
     }
+#endif
+
+#ifdef PLUGGABLE_USB_ENABLED
+    for (uint32_t ep = CDC_FIRST_ENDPOINT + CDC_ENPOINT_COUNT; ep < USB_ENDPOINTS; ep++)
+    {
+        if (Is_udd_endpoint_interrupt_enabled(ep) && Is_udd_endpoint_interrupt(ep))
+        {
+            // Nobody cares about this endpoint, stop the interrupt
+            if (!PluggableUSB().handleEndpoint(ep))
+                udd_disable_endpoint_interrupt(ep);
+        }
+    }
+#endif
 
     if (Is_udd_sof())
     {
         udd_ack_sof();
     //    USBD_Flush(CDC_TX); // jcb
+#ifdef PLUGGABLE_USB_ENABLED
+        if (Is_udd_sof_interrupt_enabled())
+            PluggableUSB().handleSOF(udd_micro_frame_number());
+#endif
     }
+
+    if (Is_udd_msof())
+    {
+        udd_ack_msof();
+#ifdef PLUGGABLE_USB_ENABLED
+        if (Is_udd_msof_interrupt_enabled())
+            PluggableUSB().handleSOF(udd_micro_frame_number());
 #endif
+    }
 
     // EP 0 Interrupt
     if (Is_udd_endpoint_interrupt(0) )
@@ -647,6 +811,7 @@ static void USB_ISR(void)
         USBSetup setup;
         UDD_Recv(EP0, (uint8_t*)&setup, 8);
         UDD_ClearSetupInt();
+        _usbStats.setups++;
 
         uint8_t requestType = setup.bmRequestType;
         if (requestType & REQUEST_DEVICETOHOST)
@@ -805,6 +970,11 @@ static void USB_ISR(void)
             {
                 _usbSetInterface = setup.wValueL;
                 TRACE_CORE(puts(">>> EP0 Int: SET_INTERFACE\r\n");)
+#ifdef PLUGGABLE_USB_ENABLED
+                // Let modules with alternate settings (isochronous streaming
+                // interfaces) start or stop their endpoints
+                PluggableUSB().setup(setup);
+#endif
             }
         }
         else
@@ -826,6 +996,7 @@ static void USB_ISR(void)
         {
             TRACE_CORE(puts(">>> EP0 Int: Stall\r\n");)
             UDD_Stall();
+            _usbStats.stalls++;
         }
     }
 }
@@ -836,6 +1007,38 @@ void USBD_Flush(uint32_t ep)
         UDD_ReleaseTX(ep);
 }
 
+const USBD_Stats& USBD_GetStats(void)
+{
+    return _usbStats;
+}
+
+void USBD_ClearStats(void)
+{
+    irqflags_t flags = cpu_irq_save();
+    memset(&_usbStats, 0, sizeof(_usbStats));
+    cpu_irq_restore(flags);
+}
+
+//    The frame number counts milliseconds of the host's clock and wraps
+//    after 2048 frames
+uint32_t USBD_SampleThroughput(uint32_t ep, USBD_ThroughputSample& sample)
+{
+    ep &= 0xF;
+    irqflags_t flags = cpu_irq_save();
+    uint16_t frame = UDD_GetFrameNumber();
+    uint32_t bytes = _usbStats.ep[ep].bytesIn + _usbStats.ep[ep].bytesOut;
+    cpu_irq_restore(flags);
+
+    uint32_t frames = (frame - sample.frame) & 0x7FF;
+    if (frames == 0)
+        return 0;
+
+    uint32_t delta = bytes - sample.bytes;
+    sample.frame = frame;
+    sample.bytes = bytes;
+    return (uint32_t)(((uint64_t)delta * 1000) / frames);
+}
+
 //    VBUS or counting frames
 //    Any frame counting?
 uint32_t USBD_Connected(void)
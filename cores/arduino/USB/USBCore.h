@@ -101,6 +101,15 @@
 #define USB_ENDPOINT_TYPE_BULK                 0x02
 #define USB_ENDPOINT_TYPE_INTERRUPT            0x03
 
+// bmAttributes synchronization and usage type of isochronous endpoints
+#define USB_ENDPOINT_SYNC_NONE                 0x00
+#define USB_ENDPOINT_SYNC_ASYNCHRONOUS         0x04
+#define USB_ENDPOINT_SYNC_ADAPTIVE             0x08
+#define USB_ENDPOINT_SYNC_SYNCHRONOUS          0x0C
+#define USB_ENDPOINT_USAGE_DATA                0x00
+#define USB_ENDPOINT_USAGE_FEEDBACK            0x10
+#define USB_ENDPOINT_USAGE_IMPLICIT_FEEDBACK   0x20
+
 #define TOBYTES(x) ((x) & 0xFF),(((x) >> 8) & 0xFF)
 
 #define CDC_V1_10                               0x0110
@@ -278,6 +287,11 @@ _Pragma("pack()")
 #define D_INTERFACE(_n,_numEndpoints,_class,_subClass,_protocol) \
 	{ 9, 4, _n, 0, _numEndpoints, _class,_subClass, _protocol, 0 }
 
+// Alternate setting of an interface, i.e. the streaming setting of an
+// interface whose alternate 0 is the zero bandwidth one
+#define D_INTERFACE_ALT(_n,_alt,_numEndpoints,_class,_subClass,_protocol) \
+	{ 9, 4, _n, _alt, _numEndpoints, _class,_subClass, _protocol, 0 }
+
 #define D_ENDPOINT(_addr,_attr,_packetSize, _interval) \
 	{ 7, 5, (uint8_t)(_addr),_attr,_packetSize, _interval }
 
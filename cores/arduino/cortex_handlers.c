@@ -32,6 +32,8 @@ static void __halt() {
 extern void svcHook(void);
 extern void pendSVHook(void);
 extern int sysTickHook(void);
+extern void dmacHook(void);
+extern void captureHook(uint32_t tcChannel);
 
 /* Cortex-M3 core handlers */
 void NMI_Handler       (void) __attribute__ ((weak, alias("__halt")));
@@ -98,21 +100,26 @@ void SPI0_Handler       (void) __attribute__ ((weak, alias("__halt")));
 void SPI1_Handler       (void) __attribute__ ((weak, alias("__halt")));
 #endif
 void SSC_Handler        (void) __attribute__ ((weak, alias("__halt")));
-void TC0_Handler        (void) __attribute__ ((weak, alias("__halt")));
+void TC0_Handler        (void) __attribute__ ((weak));
+void TC0_Handler        (void) { captureHook(0); }
 void TC1_Handler        (void) __attribute__ ((weak, alias("__halt")));
 void TC2_Handler        (void) __attribute__ ((weak, alias("__halt")));
 void TC3_Handler        (void) __attribute__ ((weak, alias("__halt")));
 void TC4_Handler        (void) __attribute__ ((weak, alias("__halt")));
 void TC5_Handler        (void) __attribute__ ((weak, alias("__halt")));
 #ifdef _SAM3XA_TC2_INSTANCE_
-void TC6_Handler        (void) __attribute__ ((weak, alias("__halt")));
-void TC7_Handler        (void) __attribute__ ((weak, alias("__halt")));
-void TC8_Handler        (void) __attribute__ ((weak, alias("__halt")));
+void TC6_Handler        (void) __attribute__ ((weak));
+void TC6_Handler        (void) { captureHook(6); }
+void TC7_Handler        (void) __attribute__ ((weak));
+void TC7_Handler        (void) { captureHook(7); }
+void TC8_Handler        (void) __attribute__ ((weak));
+void TC8_Handler        (void) { captureHook(8); }
 #endif
 void PWM_Handler        (void) __attribute__ ((weak, alias("__halt")));
 void ADC_Handler        (void) __attribute__ ((weak, alias("__halt")));
 void DACC_Handler       (void) __attribute__ ((weak, alias("__halt")));
-void DMAC_Handler       (void) __attribute__ ((weak, alias("__halt")));
+void DMAC_Handler       (void) __attribute__ ((weak));
+void DMAC_Handler       (void) { dmacHook(); }
 void UOTGHS_Handler     (void) __attribute__ ((weak, alias("__halt")));
 void TRNG_Handler       (void) __attribute__ ((weak, alias("__halt")));
 #ifdef _SAM3XA_EMAC_INSTANCE_
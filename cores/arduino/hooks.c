@@ -16,6 +16,8 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include <stdint.h>
+
 /**
  * Empty yield() hook.
  *
@@ -56,3 +58,23 @@ static void __halt() {
 }
 void svcHook(void)    __attribute__ ((weak, alias("__halt")));
 void pendSVHook(void) __attribute__ ((weak, alias("__halt")));
+
+/**
+ * DMAC hook
+ *
+ * This function is called from the default DMAC handler. wiring_dmac.c
+ * provides it as soon as dmacAttachInterrupt() is used, a sketch defining
+ * its own DMAC_Handler still replaces both. Default action is halting.
+ */
+void dmacHook(void) __attribute__ ((weak, alias("__halt")));
+
+/**
+ * Capture hook
+ *
+ * This function is called from the default TC0, TC6, TC7 and TC8 handlers
+ * with the timer channel. wiring_capture.c provides it as soon as
+ * captureStart() is used. Libraries and sketches defining their own
+ * TCx_Handler (Servo, timer libraries) replace the default handler and
+ * capture on that channel stops working. Default action is halting.
+ */
+void captureHook(uint32_t tcChannel) __attribute__ ((weak, alias("__halt")));
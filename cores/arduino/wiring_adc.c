@@ -0,0 +1,302 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+
+// Only TIOA0 to TIOA2 can trigger the ADC. TIOA0 is used by analogWrite()
+// on pin 2, channel 2 is shared with the microphone of USBAudio.
+#define ADC_TRIGGER_CHANNEL 2
+#define ADC_TRIGGER_ID      ID_TC2
+
+// Conversions per second of the ADC at 20MHz
+#define ADC_MAX_RATE        1000000
+
+static void (*callbackAdc)(void) ;
+
+static uint16_t *streamBuffer ;
+static uint32_t streamHalf ;
+static void (*streamCallback)(uint16_t *, uint32_t) ;
+static uint32_t streamChannels ;
+
+// Decimation of the stream, see analogReadOversampling()
+#define CIC_MAX_ORDER       3
+
+static uint32_t cicRatio = 1 ;
+static uint32_t cicOrder = 1 ;
+static uint32_t cicResolution = ADC_RESOLUTION ;
+static uint32_t cicIntegrator[12][CIC_MAX_ORDER] ;
+static uint32_t cicComb[12][CIC_MAX_ORDER] ;
+
+static uint32_t watchChannel ;
+static void (*watchCallback)(uint32_t, uint32_t) ;
+
+void adcAttachInterrupt( void (*callback)(void) )
+{
+	callbackAdc = callback ;
+	NVIC_EnableIRQ( ADC_IRQn ) ;
+}
+
+void adcDetachInterrupt( void )
+{
+	NVIC_DisableIRQ( ADC_IRQn ) ;
+	adc_disable_interrupt( ADC, 0xFFFFFFFF ) ;
+	callbackAdc = NULL ;
+}
+
+void ADC_Handler( void )
+{
+	if ( callbackAdc )
+		callbackAdc() ;
+}
+
+// CIC filter, integrators on every sample, combs on every cicRatio-th. The
+// arithmetic wraps modulo 2^32, which is harmless as long as the output fits.
+// Results overwrite the block in place, they are never ahead of the input.
+static uint32_t analogReadDecimate( uint16_t *samples, uint32_t count )
+{
+	uint32_t frames = count / streamChannels ;
+	uint32_t shift = cicOrder * (31 - __builtin_clz( cicRatio )) + ADC_RESOLUTION ;
+	uint16_t *in = samples ;
+	uint16_t *out = samples ;
+	uint32_t f, c, n ;
+
+	for ( f = 0 ; f < frames ; f++ )
+	{
+		for ( c = 0 ; c < streamChannels ; c++ )
+		{
+			uint32_t *integrator = cicIntegrator[c] ;
+			uint32_t value = *in++ ;
+			for ( n = 0 ; n < cicOrder ; n++ )
+				value = integrator[n] += value ;
+		}
+
+		if ( (f + 1) % cicRatio != 0 )
+			continue ;
+
+		for ( c = 0 ; c < streamChannels ; c++ )
+		{
+			uint32_t *comb = cicComb[c] ;
+			uint32_t value = cicIntegrator[c][cicOrder - 1] ;
+			for ( n = 0 ; n < cicOrder ; n++ )
+			{
+				uint32_t delayed = comb[n] ;
+				comb[n] = value ;
+				value -= delayed ;
+			}
+			if ( shift > cicResolution )
+				value >>= shift - cicResolution ;
+			else
+				value <<= cicResolution - shift ;
+			*out++ = value ;
+		}
+	}
+
+	return out - samples ;
+}
+
+static void analogReadStreamHandler( void )
+{
+	if ( (adc_get_status( ADC ) & ADC_ISR_ENDRX) == 0 )
+		return ;
+
+	// The PDC has moved on to the other half, the one it left is complete.
+	// It is queued again right away, after the half now being filled.
+	uint16_t *done = streamBuffer ;
+	if ( ADC->ADC_RPR - (uint32_t)streamBuffer < streamHalf * sizeof(uint16_t) )
+		done += streamHalf ;
+
+	ADC->ADC_RNPR = (uint32_t)done ;
+	ADC->ADC_RNCR = streamHalf ;
+
+	uint32_t count = streamHalf ;
+	if ( cicRatio > 1 || cicResolution != ADC_RESOLUTION )
+		count = analogReadDecimate( done, streamHalf ) ;
+
+	if ( streamCallback )
+		streamCallback( done, count ) ;
+}
+
+uint32_t analogReadStart( const uint32_t *pins, uint32_t count, uint32_t sampleRate,
+                          uint16_t *buffer, uint32_t size,
+                          void (*callback)(uint16_t *samples, uint32_t count) )
+{
+	uint32_t mask = 0 ;
+	uint32_t i ;
+
+	if ( count == 0 || sampleRate == 0 || buffer == NULL || watchCallback != NULL )
+		return 0 ;
+
+	for ( i = 0 ; i < count ; i++ )
+	{
+		uint32_t ulPin = pins[i] ;
+		if ( ulPin < A0 )
+			ulPin += A0 ;
+		if ( ulPin >= PINS_COUNT )
+			return 0 ;
+
+		EAnalogChannel channel = g_APinDescription[ulPin].ulAnalogChannel ;
+		if ( channel == NO_ADC || channel > ADC11 )
+			return 0 ;
+		mask |= 1u << g_APinDescription[ulPin].ulADCChannelNumber ;
+	}
+
+	// Halves hold whole conversion sequences, as many as decimated at once
+	uint32_t channels = __builtin_popcount( mask ) ;
+	uint32_t half = (size / 2) / (channels * cicRatio) * (channels * cicRatio) ;
+	if ( half == 0 || sampleRate > ADC_MAX_RATE / channels / cicRatio )
+		return 0 ;
+
+	analogReadStop() ;
+
+	for ( i = 0 ; i < count ; i++ )
+	{
+		uint32_t ulPin = pins[i] < A0 ? pins[i] + A0 : pins[i] ;
+		g_pinStatus[ulPin] = (g_pinStatus[ulPin] & 0xF0) | PIN_STATUS_ANALOG ;
+	}
+
+	// TIOA rises on RC compare, that edge starts a conversion sequence
+	uint32_t rate = sampleRate * cicRatio ;
+	uint32_t rc = ((VARIANT_MCK / 2) + rate / 2) / rate ;
+	pmc_enable_periph_clk( ADC_TRIGGER_ID ) ;
+	TC_Configure( TC0, ADC_TRIGGER_CHANNEL, TC_CMR_TCCLKS_TIMER_CLOCK1 | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC |
+		TC_CMR_ACPA_CLEAR | TC_CMR_ACPC_SET ) ;
+	TC_SetRC( TC0, ADC_TRIGGER_CHANNEL, rc ) ;
+	TC_SetRA( TC0, ADC_TRIGGER_CHANNEL, rc / 2 ) ;
+
+	streamBuffer = buffer ;
+	streamHalf = half ;
+	streamCallback = callback ;
+	streamChannels = channels ;
+	memset( cicIntegrator, 0, sizeof( cicIntegrator ) ) ;
+	memset( cicComb, 0, sizeof( cicComb ) ) ;
+
+	adc_disable_all_channel( ADC ) ;
+	ADC->ADC_CHER = mask ;
+	adc_configure_trigger( ADC, ADC_TRIG_TIO_CH_2, 0 ) ;
+	// Drop a conversion left over by analogRead()
+	ADC->ADC_LCDR ;
+
+	ADC->ADC_PTCR = PERIPH_PTCR_RXTDIS ;
+	ADC->ADC_RPR = (uint32_t)buffer ;
+	ADC->ADC_RCR = half ;
+	ADC->ADC_RNPR = (uint32_t)(buffer + half) ;
+	ADC->ADC_RNCR = half ;
+	ADC->ADC_PTCR = PERIPH_PTCR_RXTEN ;
+	adcAttachInterrupt( analogReadStreamHandler ) ;
+	adc_enable_interrupt( ADC, ADC_IER_ENDRX ) ;
+
+	TC_Start( TC0, ADC_TRIGGER_CHANNEL ) ;
+	return (VARIANT_MCK / 2) / rc / cicRatio ;
+}
+
+uint32_t analogReadOversampling( uint32_t ratio, uint32_t order, uint32_t resolution )
+{
+	// Power of two ratios only, the sum of order stages must fit in 32 bits
+	if ( ratio == 0 || (ratio & (ratio - 1)) != 0 || ratio > 256 )
+		return 0 ;
+	if ( order == 0 || order > CIC_MAX_ORDER || resolution == 0 || resolution > 16 )
+		return 0 ;
+	if ( ADC_RESOLUTION + order * (31 - __builtin_clz( ratio )) > 32 )
+		return 0 ;
+	if ( streamBuffer != NULL )
+		return 0 ;
+
+	cicRatio = ratio ;
+	cicOrder = order ;
+	cicResolution = resolution ;
+	return 1 ;
+}
+
+void analogReadStop( void )
+{
+	if ( streamBuffer == NULL )
+		return ;
+
+	TC_Stop( TC0, ADC_TRIGGER_CHANNEL ) ;
+	adcDetachInterrupt() ;
+	ADC->ADC_PTCR = PERIPH_PTCR_RXTDIS ;
+	adc_configure_trigger( ADC, ADC_TRIG_SW, 0 ) ;
+	adc_disable_all_channel( ADC ) ;
+	streamBuffer = NULL ;
+}
+
+// The comparator fires on every conversion matching the mode, it is turned
+// round after each event so that only crossings are reported
+static void analogWatchHandler( void )
+{
+	if ( (adc_get_status( ADC ) & ADC_ISR_COMPE) == 0 )
+		return ;
+
+	uint32_t value = adc_get_channel_value( ADC, (enum adc_channel_num_t)watchChannel ) ;
+	uint32_t inside = adc_get_comparison_mode( ADC ) == ADC_EMR_CMPMODE_IN ;
+	adc_set_comparison_mode( ADC, inside ? ADC_EMR_CMPMODE_OUT : ADC_EMR_CMPMODE_IN ) ;
+
+	if ( watchCallback )
+		watchCallback( value, inside ) ;
+}
+
+uint32_t analogWatchStart( uint32_t ulPin, uint32_t low, uint32_t high,
+                           void (*callback)(uint32_t value, uint32_t inside) )
+{
+	if ( ulPin < A0 )
+		ulPin += A0 ;
+	if ( ulPin >= PINS_COUNT || callback == NULL || low > high || high > 4095 )
+		return 0 ;
+
+	EAnalogChannel channel = g_APinDescription[ulPin].ulAnalogChannel ;
+	if ( channel == NO_ADC || channel > ADC11 || streamBuffer != NULL )
+		return 0 ;
+
+	analogWatchStop() ;
+	g_pinStatus[ulPin] = (g_pinStatus[ulPin] & 0xF0) | PIN_STATUS_ANALOG ;
+
+	watchChannel = g_APinDescription[ulPin].ulADCChannelNumber ;
+	watchCallback = callback ;
+
+	adc_disable_all_channel( ADC ) ;
+	adc_enable_channel( ADC, (enum adc_channel_num_t)watchChannel ) ;
+	adc_set_comparison_channel( ADC, (enum adc_channel_num_t)watchChannel ) ;
+	adc_set_comparison_window( ADC, low, high ) ;
+	// An event needs four conversions in a row on the same side, so noise
+	// right at a threshold does not flood the interrupt
+	ADC->ADC_EMR = (ADC->ADC_EMR & ~ADC_EMR_CMPFILTER_Msk) | ADC_EMR_CMPFILTER( 3 ) ;
+	// The signal is assumed inside, if it is not the first event comes at once
+	adc_set_comparison_mode( ADC, ADC_EMR_CMPMODE_OUT ) ;
+	adc_get_status( ADC ) ;
+
+	adcAttachInterrupt( analogWatchHandler ) ;
+	adc_enable_interrupt( ADC, ADC_IER_COMPE ) ;
+
+	// Converts over and over without any trigger
+	adc_configure_trigger( ADC, ADC_TRIG_SW, 0 ) ;
+	ADC->ADC_MR |= ADC_MR_FREERUN_ON ;
+	adc_start( ADC ) ;
+	return 1 ;
+}
+
+void analogWatchStop( void )
+{
+	if ( watchCallback == NULL )
+		return ;
+
+	adcDetachInterrupt() ;
+	adc_configure_trigger( ADC, ADC_TRIG_SW, 0 ) ;
+	ADC->ADC_EMR &= ~(ADC_EMR_CMPMODE_Msk | ADC_EMR_CMPFILTER_Msk) ;
+	adc_disable_all_channel( ADC ) ;
+	watchCallback = NULL ;
+}
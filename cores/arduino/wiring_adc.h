@@ -0,0 +1,123 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _WIRING_ADC_
+#define _WIRING_ADC_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * \brief Registers the function called from ADC_Handler. Whoever takes the
+ * ADC over from analogRead() (continuous sampling, USBAudio...) installs its
+ * handler here and enables the interrupts it needs in ADC_IER.
+ *
+ * \param callback Function called in interrupt context.
+ */
+extern void adcAttachInterrupt( void (*callback)(void) ) ;
+
+/*
+ * \brief Disables all ADC interrupts and removes the callback.
+ */
+extern void adcDetachInterrupt( void ) ;
+
+/*
+ * \brief Starts continuous sampling of one or more analog pins. A timer
+ * (TC0 channel 2) triggers a conversion of all the pins sampleRate times
+ * per second, the PDC writes the results to buffer.
+ *
+ * The buffer is used as two halves: while one is filled, callback is called
+ * with the other one, which stays untouched until the next call. Samples are
+ * 12 bit unless set otherwise by analogReadOversampling(), interleaved per conversion in ascending ADC channel order (A7 to
+ * A0, then A8 to A11). analogRead() must not be used until analogReadStop().
+ *
+ * \param pins Analog pins (A0 to A11, or 0 to 11).
+ * \param count Number of pins.
+ * \param sampleRate Conversions per second and pin, up to 1000000 for all
+ * pins together, including the ratio of analogReadOversampling().
+ * \param buffer Receives the samples.
+ * \param size Size of buffer in samples, at least two per pin and
+ * oversampling ratio.
+ * \param callback Called in interrupt context with each completed half and
+ * its number of samples, after decimation.
+ *
+ * \return The sample rate really used, 0 if the parameters are invalid.
+ */
+extern uint32_t analogReadStart( const uint32_t *pins, uint32_t count, uint32_t sampleRate,
+                                 uint16_t *buffer, uint32_t size,
+                                 void (*callback)(uint16_t *samples, uint32_t count) ) ;
+
+/*
+ * \brief Configures the decimation applied by analogReadStart(). The ADC then
+ * converts ratio times faster than the requested sample rate, and each block
+ * is reduced by a CIC filter of the given order (1 is a plain average) before
+ * it is passed to the callback. Every factor 4 of oversampling adds one bit of
+ * resolution, provided the input carries some noise.
+ *
+ * The SAM3X ADC has no averaging of its own. The filter runs in the PDC block
+ * interrupt, a few additions per sample, so the buffer should hold at least a
+ * few hundred samples. Takes effect on the next analogReadStart().
+ *
+ * \param ratio Oversampling ratio, a power of 2 up to 256. 1 disables it.
+ * \param order Order of the filter, 1 to 3. Higher orders attenuate more of
+ * the aliased noise, ratio^order must not exceed 2^20.
+ * \param resolution Bits of the samples passed to the callback, up to 16.
+ *
+ * \return 1 on success, 0 if the parameters are invalid or sampling is
+ * running.
+ */
+extern uint32_t analogReadOversampling( uint32_t ratio, uint32_t order, uint32_t resolution ) ;
+
+/*
+ * \brief Stops continuous sampling and gives the ADC back to analogRead().
+ */
+extern void analogReadStop( void ) ;
+
+/*
+ * \brief Watches an analog pin with the window comparator of the ADC. The ADC
+ * converts the pin over and over on its own, callback is only called when the
+ * value enters or leaves the window [low, high]. The value must stay on the
+ * new side for four conversions in a row.
+ *
+ * Watching starts as if the value were inside the window. analogRead(),
+ * analogReadScan() and analogReadStart() must not be used until
+ * analogWatchStop().
+ *
+ * \param ulPin Analog pin (A0 to A11, or 0 to 11).
+ * \param low Lower limit of the window, 12 bit.
+ * \param high Upper limit of the window, 12 bit.
+ * \param callback Called in interrupt context with the value that crossed the
+ * limit, inside is 1 when it entered the window and 0 when it left it.
+ *
+ * \return 1 on success, 0 if the parameters are invalid or continuous sampling
+ * is running.
+ */
+extern uint32_t analogWatchStart( uint32_t ulPin, uint32_t low, uint32_t high,
+                                  void (*callback)(uint32_t value, uint32_t inside) ) ;
+
+/*
+ * \brief Stops the window comparator and gives the ADC back to analogRead().
+ */
+extern void analogWatchStop( void ) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WIRING_ADC_ */
@@ -179,6 +179,157 @@ uint32_t analogRead(uint32_t ulPin)
 	return ulValue;
 }
 
+#if defined __SAM3X8E__ || defined __SAM3X8H__
+uint32_t analogReadFast(uint32_t ulPin)
+{
+	if (ulPin < A0)
+		ulPin += A0;
+
+	// Anything but this channel alone enabled goes the long way
+	uint32_t ulChannel = g_APinDescription[ulPin].ulADCChannelNumber;
+	if (ulChannel > 15 || ADC->ADC_CHSR != (1u << ulChannel))
+		return analogRead(ulPin);
+
+	ADC->ADC_CR = ADC_CR_START;
+	while ((ADC->ADC_ISR & ADC_ISR_DRDY) != ADC_ISR_DRDY)
+		;
+	return mapResolution(ADC->ADC_LCDR & ADC_LCDR_LDATA_Msk, ADC_RESOLUTION, _readResolution);
+}
+
+uint32_t analogReadTiming(uint32_t clock, uint32_t tracking, uint32_t settling)
+{
+	if (clock < ADC_FREQ_MIN || clock > ADC_FREQ_MAX || tracking > 15 || settling > 3)
+		return 0;
+
+	// ADCClock = MCK / ((PRESCAL + 1) * 2), rounded down to at most clock
+	uint32_t prescal = (VARIANT_MCK + 2 * clock - 1) / (2 * clock) - 1;
+	if (prescal > 255)
+		prescal = 255;
+
+	ADC->ADC_MR = (ADC->ADC_MR & ~(ADC_MR_PRESCAL_Msk | ADC_MR_TRACKTIM_Msk | ADC_MR_SETTLING_Msk)) |
+		ADC_MR_PRESCAL(prescal) | ADC_MR_TRACKTIM(tracking) | (settling << ADC_MR_SETTLING_Pos);
+
+	return VARIANT_MCK / ((prescal + 1) * 2);
+}
+
+uint32_t analogReadInput(uint32_t ulPin, uint32_t gain, uint32_t offset, uint32_t differential)
+{
+	if (ulPin < A0)
+		ulPin += A0;
+	if (ulPin >= PINS_COUNT)
+		return 0;
+
+	EAnalogChannel channel = g_APinDescription[ulPin].ulAnalogChannel;
+	if (channel == NO_ADC || channel > ADC11)
+		return 0;
+	uint32_t ulChannel = g_APinDescription[ulPin].ulADCChannelNumber;
+
+	// The positive input of a differential pair is the even channel
+	if (differential && (ulChannel & 1))
+		return 0;
+
+	// GAIN field: x1, x1, x2, x4 single ended, x0.5, x1, x2, x2 differential
+	uint32_t field;
+	switch (gain)
+	{
+		case 0: if (!differential) return 0; field = 0; break;
+		case 1: field = 1; break;
+		case 2: field = 2; break;
+		case 4: if (differential) return 0; field = 3; break;
+		default: return 0;
+	}
+
+	// Per channel settings are only used with ANACH, SETTLING is then
+	// inserted whenever they change between two conversions
+	ADC->ADC_MR |= ADC_MR_ANACH_ALLOWED;
+	ADC->ADC_CGR = (ADC->ADC_CGR & ~(3u << (2 * ulChannel))) | (field << (2 * ulChannel));
+	ADC->ADC_COR = (ADC->ADC_COR & ~((1u << ulChannel) | (1u << (16 + ulChannel)))) |
+		(offset ? (1u << ulChannel) : 0) | (differential ? (1u << (16 + ulChannel)) : 0);
+	return 1;
+}
+
+uint32_t analogReadScan(const uint32_t *pins, uint32_t count, uint16_t *values, uint32_t scans)
+{
+	enum adc_channel_num_t sequence[16];
+	uint16_t raw[16];
+	uint32_t used = 0;
+	uint32_t i, k;
+
+	if (count == 0 || count > 12 || values == NULL)
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		uint32_t ulPin = pins[i];
+		if (ulPin < A0)
+			ulPin += A0;
+		if (ulPin >= PINS_COUNT)
+			return 0;
+
+		EAnalogChannel channel = g_APinDescription[ulPin].ulAnalogChannel;
+		if (channel == NO_ADC || channel > ADC11)
+			return 0;
+		uint32_t ulChannel = g_APinDescription[ulPin].ulADCChannelNumber;
+		if (used & (1u << ulChannel))
+			return 0;
+		used |= 1u << ulChannel;
+		sequence[i] = (enum adc_channel_num_t)ulChannel;
+	}
+
+	// The ADC belongs to analogReadStart(), analogWatchStart() or USBAudio
+	if ((ADC->ADC_PTSR & PERIPH_PTSR_RXTEN) || (ADC->ADC_MR & (ADC_MR_TRGEN | ADC_MR_FREERUN)))
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		uint32_t ulPin = pins[i] < A0 ? pins[i] + A0 : pins[i];
+		g_pinStatus[ulPin] = (g_pinStatus[ulPin] & 0xF0) | PIN_STATUS_ANALOG;
+	}
+
+	// In sequencer mode CHER selects the slots of SEQR1/SEQR2, the
+	// conversions follow the order of pins. adc_configure_sequence()
+	// only ORs into the registers.
+	adc_disable_all_channel(ADC);
+	ADC->ADC_SEQR1 = 0;
+	ADC->ADC_SEQR2 = 0;
+	adc_configure_sequence(ADC, sequence, count);
+	ADC->ADC_CHER = (1u << count) - 1;
+	adc_start_sequencer(ADC);
+	adc_enable_tag(ADC);
+	// Drop a conversion left over by analogRead()
+	ADC->ADC_LCDR;
+
+	for (k = 0; k < scans; k++) {
+		// One trigger converts the whole sequence, the PDC collects
+		// the tagged results
+		ADC->ADC_PTCR = PERIPH_PTCR_RXTDIS;
+		ADC->ADC_RPR = (uint32_t)raw;
+		ADC->ADC_RCR = count;
+		ADC->ADC_PTCR = PERIPH_PTCR_RXTEN;
+		adc_start(ADC);
+		while ((adc_get_status(ADC) & ADC_ISR_ENDRX) != ADC_ISR_ENDRX)
+			;
+
+		for (i = 0; i < count; i++) {
+			uint32_t tag = (raw[i] & ADC_LCDR_CHNB_Msk) >> ADC_LCDR_CHNB_Pos;
+			uint32_t slot = i;
+			uint32_t j;
+			for (j = 0; j < count; j++) {
+				if (sequence[j] == tag) {
+					slot = j;
+					break;
+				}
+			}
+			values[slot * scans + k] = mapResolution(raw[i] & ADC_LCDR_LDATA_Msk, ADC_RESOLUTION, _readResolution);
+		}
+	}
+
+	ADC->ADC_PTCR = PERIPH_PTCR_RXTDIS;
+	adc_disable_tag(ADC);
+	adc_stop_sequencer(ADC);
+	adc_disable_all_channel(ADC);
+	return scans;
+}
+#endif
+
 static void TC_SetCMR_ChannelA(Tc *tc, uint32_t chan, uint32_t v)
 {
 	tc->TC_CHANNEL[chan].TC_CMR = (tc->TC_CHANNEL[chan].TC_CMR & 0xFFF0FFFF) | v;
@@ -195,6 +346,91 @@ static uint8_t TCChanEnabled[] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
 void analogOutputInit(void) {
 }
 
+void analogOutputReleaseTC(uint32_t ulTCChannel) {
+	if (ulTCChannel < sizeof(TCChanEnabled))
+		TCChanEnabled[ulTCChannel] = 0;
+}
+
+// DACC_MR bits the direct writes depend on. Both run in tag mode, every
+// sample carries its channel in bits 12-13: analogWrite() in half word mode,
+// one conversion per write, analogWriteBoth() in word mode.
+#define DACC_MODE_Msk  (DACC_MR_TRGEN | DACC_MR_WORD | DACC_MR_TAG)
+#define DACC_MODE_HALF (DACC_MR_TAG)
+#define DACC_MODE_WORD (DACC_MR_WORD | DACC_MR_TAG)
+
+void analogOutputInitDACC(void) {
+	/* Enable clock for DACC_INTERFACE */
+	pmc_enable_periph_clk(DACC_INTERFACE_ID);
+
+	/* Reset DACC registers */
+	dacc_reset(DACC_INTERFACE);
+
+	/* Half word transfer mode */
+	dacc_set_transfer_mode(DACC_INTERFACE, 0);
+
+	/* Power save:
+	 * sleep mode  - 0 (disabled)
+	 * fast wakeup - 0 (disabled)
+	 */
+	dacc_set_power_save(DACC_INTERFACE, 0, 0);
+	/* Timing:
+	 * refresh        - 0x08 (1024*8 dacc clocks)
+	 * max speed mode -    0 (disabled)
+	 * startup time   - 0x10 (1024 dacc clocks)
+	 */
+	dacc_set_timing(DACC_INTERFACE, 0x08, 0, 0x10);
+
+	/* Set up analog current */
+	dacc_set_analog_control(DACC_INTERFACE, DACC_ACR_IBCTLCH0(0x02) |
+								DACC_ACR_IBCTLCH1(0x02) |
+								DACC_ACR_IBCTLDACCORE(0x01));
+}
+
+// Sets up the DACC for the direct writes, if someone else changed it since
+// the last one
+static void analogOutputModeDACC(uint32_t target, uint32_t channels) {
+	uint32_t mode = DACC_INTERFACE->DACC_MR & DACC_MODE_Msk;
+
+	if (mode == target && (dacc_get_channel_status(DACC_INTERFACE) & channels) == channels)
+		return;
+
+	if (mode != target && dacc_get_channel_status(DACC_INTERFACE) != 0 && (mode & DACC_MR_TRGEN) == 0) {
+		// Samples written in the other mode may still be queued, they
+		// must be converted before DACC_MR changes or they end up on
+		// the wrong channel. There is no FIFO empty flag: wait until
+		// no conversion ended for longer than one takes (< 1 us).
+		while ((DACC_INTERFACE->DACC_ISR & DACC_ISR_TXRDY) == 0)
+			;
+		DACC_INTERFACE->DACC_ISR;
+		do {
+			delayMicroseconds(2);
+		} while (DACC_INTERFACE->DACC_ISR & DACC_ISR_EOC);
+	}
+
+	// Reset the DACC unless a channel is still in use
+	if (dacc_get_channel_status(DACC_INTERFACE) == 0)
+		analogOutputInitDACC();
+
+	/* The channel is taken from bits 12-13 (and 28-29 in word mode) */
+	dacc_disable_trigger(DACC_INTERFACE);
+	dacc_set_transfer_mode(DACC_INTERFACE, target == DACC_MODE_WORD);
+	dacc_enable_flexible_selection(DACC_INTERFACE);
+	if (channels & 1)
+		dacc_enable_channel(DACC_INTERFACE, 0);
+	if (channels & 2)
+		dacc_enable_channel(DACC_INTERFACE, 1);
+}
+
+void analogWriteBoth(uint32_t ulValue0, uint32_t ulValue1) {
+	analogOutputModeDACC(DACC_MODE_WORD, 3);
+
+	ulValue0 = mapResolution(ulValue0, _writeResolution, DACC_RESOLUTION);
+	ulValue1 = mapResolution(ulValue1, _writeResolution, DACC_RESOLUTION);
+	while ((DACC_INTERFACE->DACC_ISR & DACC_ISR_TXRDY) == 0)
+		;
+	DACC_INTERFACE->DACC_CDR = ulValue0 | ((ulValue1 | (1 << 12)) << 16);
+}
+
 // Right now, PWM output only works on the pins with
 // hardware support.  These are defined in the appropriate
 // pins_*.c file.  For the rest of the pins, we default
@@ -206,45 +442,15 @@ void analogWrite(uint32_t ulPin, uint32_t ulValue) {
 		EAnalogChannel channel = g_APinDescription[ulPin].ulADCChannelNumber;
 		if (channel == DA0 || channel == DA1) {
 			uint32_t chDACC = ((channel == DA0) ? 0 : 1);
-			if (dacc_get_channel_status(DACC_INTERFACE) == 0) {
-				/* Enable clock for DACC_INTERFACE */
-				pmc_enable_periph_clk(DACC_INTERFACE_ID);
-
-				/* Reset DACC registers */
-				dacc_reset(DACC_INTERFACE);
-
-				/* Half word transfer mode */
-				dacc_set_transfer_mode(DACC_INTERFACE, 0);
-
-				/* Power save:
-				 * sleep mode  - 0 (disabled)
-				 * fast wakeup - 0 (disabled)
-				 */
-				dacc_set_power_save(DACC_INTERFACE, 0, 0);
-				/* Timing:
-				 * refresh        - 0x08 (1024*8 dacc clocks)
-				 * max speed mode -    0 (disabled)
-				 * startup time   - 0x10 (1024 dacc clocks)
-				 */
-				dacc_set_timing(DACC_INTERFACE, 0x08, 0, 0x10);
-
-				/* Set up analog current */
-				dacc_set_analog_control(DACC_INTERFACE, DACC_ACR_IBCTLCH0(0x02) |
-											DACC_ACR_IBCTLCH1(0x02) |
-											DACC_ACR_IBCTLDACCORE(0x01));
-			}
 
-			/* Disable TAG and select output channel chDACC */
-			dacc_set_channel_selection(DACC_INTERFACE, chDACC);
+			analogOutputModeDACC(DACC_MODE_HALF, 1 << chDACC);
 
-			if ((dacc_get_channel_status(DACC_INTERFACE) & (1 << chDACC)) == 0) {
-				dacc_enable_channel(DACC_INTERFACE, chDACC);
-			}
-
-			// Write user value
-			ulValue = mapResolution(ulValue, _writeResolution, DACC_RESOLUTION);
-			dacc_write_conversion_data(DACC_INTERFACE, ulValue);
-			while ((dacc_get_interrupt_status(DACC_INTERFACE) & DACC_ISR_EOC) == 0);
+			// Write user value as soon as the FIFO has room, the
+			// conversion goes on on its own
+			ulValue = mapResolution(ulValue, _writeResolution, DACC_RESOLUTION) | (chDACC << 12);
+			while ((DACC_INTERFACE->DACC_ISR & DACC_ISR_TXRDY) == 0)
+				;
+			DACC_INTERFACE->DACC_CDR = ulValue;
 			return;
 		}
 	}
@@ -47,6 +47,18 @@ extern void analogReference( eAnalogReference ulMode ) ;
  */
 extern void analogWrite( uint32_t ulPin, uint32_t ulValue ) ;
 
+/*
+ * \brief Writes DAC0 and DAC1 together, with a single access to the DACC.
+ * Like analogWrite() on the DAC pins it returns as soon as the values are
+ * queued, without waiting for the conversion. Every value carries its
+ * channel, so the two can be mixed freely; switching between them waits
+ * for the values already queued to be converted.
+ *
+ * \param ulValue0 Value of DAC0, in the resolution of analogWriteResolution().
+ * \param ulValue1 Value of DAC1.
+ */
+extern void analogWriteBoth( uint32_t ulValue0, uint32_t ulValue1 ) ;
+
 /*
  * \brief Reads the value from the specified analog pin.
  *
@@ -56,6 +68,70 @@ extern void analogWrite( uint32_t ulPin, uint32_t ulValue ) ;
  */
 extern uint32_t analogRead( uint32_t ulPin ) ;
 
+/*
+ * \brief Same as analogRead(), faster when the same pin is read over and
+ * over. As long as the pin is the one selected by the previous read, only
+ * the conversion is started and waited for.
+ *
+ * \param ulPin
+ *
+ * \return Read value from selected pin, if no error.
+ */
+extern uint32_t analogReadFast( uint32_t ulPin ) ;
+
+/*
+ * \brief Sets the ADC clock and the conversion timing. init() uses the
+ * fastest clock, no extra tracking time and the longest settling time. A
+ * conversion takes 20 ADC clocks plus the tracking time.
+ *
+ * \param clock ADC clock in Hz, 1000000 to 20000000. The prescaler gives the
+ * closest value not above it.
+ * \param tracking Tracking time in ADC clocks minus one, 0 to 15. Sources
+ * with a high impedance need more.
+ * \param settling Settling time when the gain or offset changes between
+ * channels: 0 to 3 for 3, 5, 9 or 17 ADC clocks.
+ *
+ * \return The ADC clock really used, 0 if the parameters are invalid.
+ */
+extern uint32_t analogReadTiming( uint32_t clock, uint32_t tracking, uint32_t settling ) ;
+
+/*
+ * \brief Sets the analog front end of one analog pin.
+ *
+ * \param ulPin Analog pin (A0 to A11, or 0 to 11).
+ * \param gain 1, 2 or 4 single ended. Differential inputs allow 0 for a gain
+ * of 0.5, 1 or 2, their highest gain is 2.
+ * \param offset If not 0, the input is shifted by half the reference, so that
+ * with a gain above 1 the range is centered on VREF/2.
+ * \param differential If not 0, the pin is converted against the neighbouring
+ * channel. Only possible on the even ADC channel of the pair, the pin paired
+ * with it gives the negative input (A1 against A0, A3 against A2, A5 against
+ * A4, A7 against A6, A8 against A9, A10 against A11). Results are then
+ * centered on 2048.
+ *
+ * \return 1 on success, 0 if the parameters are invalid.
+ */
+extern uint32_t analogReadInput( uint32_t ulPin, uint32_t gain, uint32_t offset, uint32_t differential ) ;
+
+/*
+ * \brief Reads several analog pins together. Each scan is started by a single
+ * trigger, the ADC sequencer converts all the pins in the given order and the
+ * PDC collects the results, tagged with their channel.
+ *
+ * The values are stored one array per pin: the scans of pins[0] come first,
+ * then the ones of pins[1] and so on, i.e. values[i * scans + k] is scan k of
+ * pins[i]. They have the resolution set by analogReadResolution().
+ *
+ * \param pins Analog pins (A0 to A11, or 0 to 11), each at most once.
+ * \param count Number of pins, up to 12.
+ * \param values Receives count * scans values.
+ * \param scans Number of times all the pins are converted.
+ *
+ * \return Number of scans done, 0 if the parameters are invalid or the ADC is
+ * in use by analogReadStart() or analogWatchStart().
+ */
+extern uint32_t analogReadScan( const uint32_t *pins, uint32_t count, uint16_t *values, uint32_t scans ) ;
+
 /*
  * \brief Set the resolution of analogRead return values. Default is 10 bits (range from 0 to 1023).
  *
@@ -72,6 +148,19 @@ extern void analogWriteResolution(int res);
 
 extern void analogOutputInit( void ) ;
 
+/*
+ * \brief Tells analogWrite() that a timer channel (0 to 8) was taken over,
+ * its next write on the channel sets it up again. For core use.
+ */
+extern void analogOutputReleaseTC( uint32_t ulTCChannel ) ;
+
+/*
+ * \brief Resets the DACC and sets the clock, timing and analog current used
+ * by all DAC outputs, in half word mode with both channels disabled. For core
+ * use.
+ */
+extern void analogOutputInitDACC( void ) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,164 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "Arduino.h"
+
+// Timer channels 0 to 8 are channels 0 to 2 of TC0, TC1 and TC2. The
+// TIOA pins of the board are on channels 0, 6, 7 and 8.
+#define CAPTURE_CHANNELS 9
+
+typedef struct
+{
+	void (*callback)(uint32_t, uint32_t) ;
+	volatile uint32_t period ;
+	volatile uint32_t high ;
+	volatile uint8_t fresh ;
+	uint8_t valid ;
+} CaptureChannel ;
+
+static CaptureChannel captures[CAPTURE_CHANNELS] ;
+
+static Tc *captureTc( uint32_t tcChannel )
+{
+	return tcChannel < 3 ? TC0 : (tcChannel < 6 ? TC1 : TC2) ;
+}
+
+// Timer channel of the TIOA pin ulPin, -1 if there is none
+static int32_t captureChannel( uint32_t ulPin )
+{
+	if ( ulPin >= PINS_COUNT || (g_APinDescription[ulPin].ulPinAttribute & PIN_ATTR_TIMER) != PIN_ATTR_TIMER )
+		return -1 ;
+	ETCChannel channel = g_APinDescription[ulPin].ulTCChannel ;
+	if ( channel == NOT_ON_TIMER || (channel & 1) != 0 )
+		return -1 ;
+	return channel / 2 ;
+}
+
+static void captureHandler( uint32_t tcChannel )
+{
+	Tc *tc = captureTc( tcChannel ) ;
+	uint32_t chNo = tcChannel % 3 ;
+	CaptureChannel *capture = &captures[tcChannel] ;
+
+	uint32_t status = TC_GetStatus( tc, chNo ) ;
+	if ( (status & TC_SR_LDRAS) == 0 )
+		return ;
+
+	// RB holds the high time of the period that just ended, unless the
+	// counter wrapped in it or it is the first edge after start
+	uint32_t high = tc->TC_CHANNEL[chNo].TC_RB ;
+	uint32_t period = tc->TC_CHANNEL[chNo].TC_RA ;
+	if ( (status & TC_SR_COVFS) || !capture->valid )
+	{
+		capture->valid = 1 ;
+		return ;
+	}
+
+	capture->period = period ;
+	capture->high = high ;
+	capture->fresh = 1 ;
+	if ( capture->callback )
+		capture->callback( period, high ) ;
+}
+
+// Called from TC0_Handler and TC6_Handler to TC8_Handler, see hooks.c
+void captureHook( uint32_t tcChannel )
+{
+	captureHandler( tcChannel ) ;
+}
+
+uint32_t captureStart( uint32_t ulPin, void (*callback)(uint32_t period, uint32_t high) )
+{
+	int32_t tcChannel = captureChannel( ulPin ) ;
+	if ( tcChannel < 0 )
+		return 0 ;
+
+	Tc *tc = captureTc( tcChannel ) ;
+	uint32_t chNo = tcChannel % 3 ;
+	CaptureChannel *capture = &captures[tcChannel] ;
+
+	captureStop( ulPin ) ;
+	capture->callback = callback ;
+	capture->period = 0 ;
+	capture->high = 0 ;
+	capture->fresh = 0 ;
+	capture->valid = 0 ;
+
+	PIO_Configure( g_APinDescription[ulPin].pPort,
+			g_APinDescription[ulPin].ulPinType,
+			g_APinDescription[ulPin].ulPin,
+			g_APinDescription[ulPin].ulPinConfiguration ) ;
+	g_pinStatus[ulPin] = (g_pinStatus[ulPin] & 0xF0) | PIN_STATUS_TIMER ;
+
+	// The channel is no longer the one analogWrite() set up
+	analogOutputReleaseTC( tcChannel ) ;
+	pmc_enable_periph_clk( TC_INTERFACE_ID + tcChannel ) ;
+	TC_Configure( tc, chNo,
+		TC_CMR_TCCLKS_TIMER_CLOCK1 |
+		TC_CMR_ABETRG |          // TIOA is the external trigger
+		TC_CMR_ETRGEDG_RISING |  // rising edges restart the counter...
+		TC_CMR_LDRA_RISING |     // ...after loading the period into RA
+		TC_CMR_LDRB_FALLING ) ;  // falling edges load the high time into RB
+
+	tc->TC_CHANNEL[chNo].TC_IER = TC_IER_LDRAS ;
+	NVIC_ClearPendingIRQ( (IRQn_Type)(TC0_IRQn + tcChannel) ) ;
+	NVIC_EnableIRQ( (IRQn_Type)(TC0_IRQn + tcChannel) ) ;
+	TC_Start( tc, chNo ) ;
+	return 1 ;
+}
+
+void captureStop( uint32_t ulPin )
+{
+	int32_t tcChannel = captureChannel( ulPin ) ;
+	if ( tcChannel < 0 )
+		return ;
+
+	Tc *tc = captureTc( tcChannel ) ;
+	uint32_t chNo = tcChannel % 3 ;
+
+	NVIC_DisableIRQ( (IRQn_Type)(TC0_IRQn + tcChannel) ) ;
+	tc->TC_CHANNEL[chNo].TC_IDR = 0xFFFFFFFF ;
+	TC_Stop( tc, chNo ) ;
+	captures[tcChannel].callback = NULL ;
+
+	// Let analogWrite() set the channel and the pin up again, on TIOA as
+	// well as on the TIOB pin sharing the channel
+	analogOutputReleaseTC( tcChannel ) ;
+	if ( (g_pinStatus[ulPin] & 0xF) == PIN_STATUS_TIMER )
+		g_pinStatus[ulPin] &= 0xF0 ;
+}
+
+uint32_t captureRead( uint32_t ulPin, uint32_t *period, uint32_t *high )
+{
+	int32_t tcChannel = captureChannel( ulPin ) ;
+	if ( tcChannel < 0 )
+		return 0 ;
+
+	CaptureChannel *capture = &captures[tcChannel] ;
+
+	// Both values from the same period
+	uint32_t primask = __get_PRIMASK() ;
+	__disable_irq() ;
+	*period = capture->period ;
+	*high = capture->high ;
+	uint32_t fresh = capture->fresh ;
+	capture->fresh = 0 ;
+	__set_PRIMASK( primask ) ;
+	return fresh ;
+}
@@ -0,0 +1,78 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef _WIRING_CAPTURE_
+#define _WIRING_CAPTURE_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Counting clock of the capture timers, MCK/2
+#define CAPTURE_CLOCK (VARIANT_MCK / 2)
+
+/*
+ * \brief Measures a signal on a TIOA pin with its timer channel in capture
+ * mode. Every rising edge resets the counter and loads the period into RA,
+ * the falling edge in between loads the high time into RB. Both are counted
+ * at CAPTURE_CLOCK (42 MHz), periods up to about 100 seconds. The CPU only
+ * takes one interrupt per period.
+ *
+ * Only pins 2, 3, 5 and 11 qualify, each uses its own timer channel; they
+ * can not do analogWrite() at the same time, nor can the TIOB pin of the
+ * same channel (13, 10, 4 and 12).
+ *
+ * The interrupt handlers of those channels (TC0_Handler, TC6_Handler to
+ * TC8_Handler) stay weak: a library or sketch defining its own one, such
+ * as Servo or a timer library using the same channel, replaces the
+ * dispatcher and the pin is not measured then.
+ *
+ * \param ulPin Pin to measure.
+ * \param callback Called in interrupt context with each period and high
+ * time, in CAPTURE_CLOCK ticks. May be NULL, captureRead() still works.
+ *
+ * \return 1 on success, 0 if the pin has no capture input.
+ */
+extern uint32_t captureStart( uint32_t ulPin, void (*callback)(uint32_t period, uint32_t high) ) ;
+
+/*
+ * \brief Stops measuring a pin. The pin and the other output of its timer
+ * channel can be used by analogWrite() again.
+ */
+extern void captureStop( uint32_t ulPin ) ;
+
+/*
+ * \brief Gets the last measurement of a pin, without waiting.
+ *
+ * \param ulPin
+ * \param period Receives the period in CAPTURE_CLOCK ticks; the frequency
+ * is CAPTURE_CLOCK / period.
+ * \param high Receives the high time in CAPTURE_CLOCK ticks; the duty
+ * cycle is high / period.
+ *
+ * \return 1 if the measurement is new since the last call, 0 otherwise or
+ * if there is none yet.
+ */
+extern uint32_t captureRead( uint32_t ulPin, uint32_t *period, uint32_t *high ) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WIRING_CAPTURE_ */
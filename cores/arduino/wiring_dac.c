@@ -0,0 +1,176 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+
+// Only TIOA0 to TIOA2 can trigger the DACC. TIOA0 is used by analogWrite()
+// on pin 2, channel 1 is shared with the speaker of USBAudio.
+#define DAC_TRIGGER_CHANNEL 1
+#define DAC_TRIGGER_ID      ID_TC1
+#define DAC_TRIGGER_SEL     2
+
+// Conversions per second of the DACC
+#define DAC_MAX_RATE        1000000
+
+// Channel selection bits of DACC_CDR in tag mode
+#define DAC_TAG_Pos         12
+
+static void (*callbackDac)(void) ;
+
+static uint16_t *streamBuffer ;
+static uint32_t streamHalf ;
+static uint32_t streamTags ;
+static void (*streamCallback)(uint16_t *, uint32_t) ;
+
+void dacAttachInterrupt( void (*callback)(void) )
+{
+	callbackDac = callback ;
+	NVIC_EnableIRQ( DACC_IRQn ) ;
+}
+
+void dacDetachInterrupt( void )
+{
+	NVIC_DisableIRQ( DACC_IRQn ) ;
+	dacc_disable_interrupt( DACC_INTERFACE, 0xFFFFFFFF ) ;
+	callbackDac = NULL ;
+}
+
+void DACC_Handler( void )
+{
+	if ( callbackDac )
+		callbackDac() ;
+}
+
+// The callback fills a half, in tag mode the channel of every sample is set
+// here afterwards
+static void analogWriteFill( uint16_t *samples )
+{
+	uint32_t i ;
+
+	if ( streamCallback )
+		streamCallback( samples, streamHalf ) ;
+
+	if ( streamTags == 0 )
+		return ;
+	for ( i = 0 ; i < streamHalf ; i += 2 )
+	{
+		samples[i] = (samples[i] & 0xFFF) | (streamTags & 0xFFFF) ;
+		samples[i + 1] = (samples[i + 1] & 0xFFF) | (streamTags >> 16) ;
+	}
+}
+
+static void analogWriteStreamHandler( void )
+{
+	if ( (dacc_get_interrupt_status( DACC_INTERFACE ) & DACC_ISR_ENDTX) == 0 )
+		return ;
+
+	// The PDC has moved on to the other half, the one it left is free.
+	// It is filled and queued again, after the half now being sent.
+	uint16_t *done = streamBuffer ;
+	if ( DACC_INTERFACE->DACC_TPR - (uint32_t)streamBuffer < streamHalf * sizeof(uint16_t) )
+		done += streamHalf ;
+
+	analogWriteFill( done ) ;
+	DACC_INTERFACE->DACC_TNPR = (uint32_t)done ;
+	DACC_INTERFACE->DACC_TNCR = streamHalf ;
+}
+
+uint32_t analogWriteStart( const uint32_t *pins, uint32_t count, uint32_t sampleRate,
+                           uint16_t *buffer, uint32_t size,
+                           void (*callback)(uint16_t *samples, uint32_t count) )
+{
+	uint32_t channels[2] ;
+	uint32_t i ;
+
+	if ( count == 0 || count > 2 || sampleRate == 0 || buffer == NULL )
+		return 0 ;
+
+	for ( i = 0 ; i < count ; i++ )
+	{
+		if ( pins[i] >= PINS_COUNT )
+			return 0 ;
+		EAnalogChannel channel = g_APinDescription[pins[i]].ulADCChannelNumber ;
+		if ( channel != DA0 && channel != DA1 )
+			return 0 ;
+		channels[i] = (channel == DA0) ? 0 : 1 ;
+	}
+	if ( count == 2 && channels[0] == channels[1] )
+		return 0 ;
+
+	// Halves hold whole frames
+	uint32_t half = (size / 2) / count * count ;
+	if ( half == 0 || sampleRate > DAC_MAX_RATE / count )
+		return 0 ;
+
+	analogWriteStop() ;
+
+	// TIOA rises on RC compare, that edge starts a conversion
+	uint32_t rate = sampleRate * count ;
+	uint32_t rc = ((VARIANT_MCK / 2) + rate / 2) / rate ;
+	pmc_enable_periph_clk( DAC_TRIGGER_ID ) ;
+	TC_Configure( TC0, DAC_TRIGGER_CHANNEL, TC_CMR_TCCLKS_TIMER_CLOCK1 | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC |
+		TC_CMR_ACPA_CLEAR | TC_CMR_ACPC_SET ) ;
+	TC_SetRC( TC0, DAC_TRIGGER_CHANNEL, rc ) ;
+	TC_SetRA( TC0, DAC_TRIGGER_CHANNEL, rc / 2 ) ;
+
+	streamBuffer = buffer ;
+	streamHalf = half ;
+	streamCallback = callback ;
+	streamTags = 0 ;
+	if ( count == 2 )
+		streamTags = (channels[0] << DAC_TAG_Pos) | (channels[1] << (16 + DAC_TAG_Pos)) ;
+
+	analogOutputInitDACC() ;
+	// With two pins the channel is taken from bits 12-13 of each sample
+	if ( count == 2 )
+		dacc_enable_flexible_selection( DACC_INTERFACE ) ;
+	else
+		dacc_set_channel_selection( DACC_INTERFACE, channels[0] ) ;
+	for ( i = 0 ; i < count ; i++ )
+		dacc_enable_channel( DACC_INTERFACE, channels[i] ) ;
+	dacc_set_trigger( DACC_INTERFACE, DAC_TRIGGER_SEL ) ;
+
+	analogWriteFill( buffer ) ;
+	analogWriteFill( buffer + half ) ;
+
+	DACC_INTERFACE->DACC_PTCR = PERIPH_PTCR_TXTDIS ;
+	DACC_INTERFACE->DACC_TPR = (uint32_t)buffer ;
+	DACC_INTERFACE->DACC_TCR = half ;
+	DACC_INTERFACE->DACC_TNPR = (uint32_t)(buffer + half) ;
+	DACC_INTERFACE->DACC_TNCR = half ;
+	DACC_INTERFACE->DACC_PTCR = PERIPH_PTCR_TXTEN ;
+	dacAttachInterrupt( analogWriteStreamHandler ) ;
+	dacc_enable_interrupt( DACC_INTERFACE, DACC_IER_ENDTX ) ;
+
+	TC_Start( TC0, DAC_TRIGGER_CHANNEL ) ;
+	return (VARIANT_MCK / 2) / rc / count ;
+}
+
+void analogWriteStop( void )
+{
+	if ( streamBuffer == NULL )
+		return ;
+
+	TC_Stop( TC0, DAC_TRIGGER_CHANNEL ) ;
+	dacDetachInterrupt() ;
+	DACC_INTERFACE->DACC_PTCR = PERIPH_PTCR_TXTDIS ;
+	dacc_disable_trigger( DACC_INTERFACE ) ;
+	dacc_disable_channel( DACC_INTERFACE, 0 ) ;
+	dacc_disable_channel( DACC_INTERFACE, 1 ) ;
+	streamBuffer = NULL ;
+}
@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _WIRING_DAC_
+#define _WIRING_DAC_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * \brief Registers the function called from DACC_Handler. Whoever takes the
+ * DACC over from analogWrite() (waveform output, USBAudio...) installs its
+ * handler here and enables the interrupts it needs in DACC_IER.
+ *
+ * \param callback Function called in interrupt context.
+ */
+extern void dacAttachInterrupt( void (*callback)(void) ) ;
+
+/*
+ * \brief Disables all DACC interrupts and removes the callback.
+ */
+extern void dacDetachInterrupt( void ) ;
+
+/*
+ * \brief Starts continuous output on DAC0, DAC1 or both. A timer (TC0
+ * channel 1) triggers a conversion sampleRate times per second and pin, the
+ * PDC feeds the DACC from buffer.
+ *
+ * The buffer is used as two halves: callback is called with each half to
+ * fill, both before the output starts and then every time the DACC has
+ * finished one half. Samples are 12 bit; with two pins they are interleaved
+ * in the order of pins. analogWrite() must not be used on the DAC pins until
+ * analogWriteStop().
+ *
+ * \param pins DAC pins (DAC0, DAC1).
+ * \param count Number of pins, 1 or 2.
+ * \param sampleRate Conversions per second and pin, up to 1000000 for both
+ * pins together.
+ * \param buffer Holds the samples.
+ * \param size Size of buffer in samples, at least two per pin.
+ * \param callback Called with a half to fill and its number of samples, in
+ * interrupt context once the output runs. Without callback the content of
+ * buffer is repeated over and over.
+ *
+ * \return The sample rate really used, 0 if the parameters are invalid.
+ */
+extern uint32_t analogWriteStart( const uint32_t *pins, uint32_t count, uint32_t sampleRate,
+                                  uint16_t *buffer, uint32_t size,
+                                  void (*callback)(uint16_t *samples, uint32_t count) ) ;
+
+/*
+ * \brief Stops continuous output and gives the DACC back to analogWrite().
+ */
+extern void analogWriteStop( void ) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WIRING_DAC_ */
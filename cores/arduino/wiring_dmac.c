@@ -0,0 +1,59 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+
+#define DMAC_CHANNEL_STATUS(ch) ((DMAC_EBCISR_BTC0 | DMAC_EBCISR_CBTC0 | DMAC_EBCISR_ERR0) << (ch))
+
+typedef void (*dmacCB)(void);
+
+static dmacCB callbacksDmac[DMACCH_NUM_NUMBER];
+
+void dmacAttachInterrupt( uint32_t ulChannel, void (*callback)(void) )
+{
+	if ( ulChannel >= DMACCH_NUM_NUMBER )
+		return ;
+
+	callbacksDmac[ulChannel] = callback ;
+
+	pmc_enable_periph_clk( ID_DMAC ) ;
+	NVIC_EnableIRQ( DMAC_IRQn ) ;
+}
+
+void dmacDetachInterrupt( uint32_t ulChannel )
+{
+	if ( ulChannel >= DMACCH_NUM_NUMBER )
+		return ;
+
+	DMAC->DMAC_EBCIDR = DMAC_CHANNEL_STATUS( ulChannel ) ;
+	callbacksDmac[ulChannel] = NULL ;
+}
+
+// Called from DMAC_Handler, see hooks.c
+void dmacHook( void )
+{
+	// Reading the status clears it for all channels
+	uint32_t status = DMAC->DMAC_EBCISR & DMAC->DMAC_EBCIMR ;
+	uint32_t ch ;
+
+	for ( ch = 0 ; ch < DMACCH_NUM_NUMBER ; ch++ )
+	{
+		if ( (status & DMAC_CHANNEL_STATUS( ch )) && callbacksDmac[ch] )
+			callbacksDmac[ch]() ;
+	}
+}
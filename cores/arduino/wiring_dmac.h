@@ -0,0 +1,50 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _WIRING_DMAC_
+#define _WIRING_DMAC_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * \brief The DMA controller has a single interrupt shared by its six channels.
+ * Libraries driving a channel register a callback here; it is called from
+ * DMAC_Handler when the channel reports a completed buffer (BTC/CBTC) or an
+ * access error, provided those interrupts are enabled in DMAC_EBCIER.
+ * DMAC_Handler stays weak: a sketch defining its own one replaces the
+ * dispatcher, callbacks registered here are not called then.
+ *
+ * \param ulChannel DMAC channel, 0 to 5.
+ * \param callback Function called in interrupt context.
+ */
+extern void dmacAttachInterrupt( uint32_t ulChannel, void (*callback)(void) ) ;
+
+/*
+ * \brief Disables the interrupts of the channel and removes its callback.
+ *
+ * \param ulChannel DMAC channel, 0 to 5.
+ */
+extern void dmacDetachInterrupt( uint32_t ulChannel ) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WIRING_DMAC_ */
@@ -0,0 +1,225 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "Arduino.h"
+
+// Largest period of a PWM channel, and the largest master clock divider
+#define PWM_SYNC_MAX_PERIOD 65535
+#define PWM_SYNC_MAX_PRE    10
+
+static void (*callbackPwm)(void) ;
+
+// Channels of the group, as PWM_SCM SYNCx bits, and in the order of pins
+static uint32_t syncChannels ;
+static uint8_t syncPins[PWMCH_NUM_NUMBER] ;
+static uint8_t syncPinNumbers[PWMCH_NUM_NUMBER] ;
+static uint32_t syncCount ;
+
+static uint16_t *streamBuffer ;
+static uint32_t streamHalf ;
+static void (*streamCallback)(uint16_t *, uint32_t) ;
+
+void pwmAttachInterrupt( void (*callback)(void) )
+{
+	callbackPwm = callback ;
+	NVIC_EnableIRQ( PWM_IRQn ) ;
+}
+
+void pwmDetachInterrupt( void )
+{
+	NVIC_DisableIRQ( PWM_IRQn ) ;
+	PWM_INTERFACE->PWM_IDR1 = 0xFFFFFFFF ;
+	PWM_INTERFACE->PWM_IDR2 = 0xFFFFFFFF ;
+	callbackPwm = NULL ;
+}
+
+void PWM_Handler( void )
+{
+	if ( callbackPwm )
+		callbackPwm() ;
+}
+
+uint32_t pwmSyncBegin( const uint32_t *pins, uint32_t count, uint32_t frequency )
+{
+	uint32_t channels = PWM_SCM_SYNC0 ;
+	uint32_t pre, period = 0 ;
+	uint32_t i ;
+
+	if ( count == 0 || count >= PWMCH_NUM_NUMBER || frequency == 0 )
+		return 0 ;
+
+	for ( i = 0 ; i < count ; i++ )
+	{
+		if ( pins[i] >= PINS_COUNT || (g_APinDescription[pins[i]].ulPinAttribute & PIN_ATTR_PWM) != PIN_ATTR_PWM )
+			return 0 ;
+		uint32_t chan = g_APinDescription[pins[i]].ulPWMChannel ;
+		if ( channels & (1u << chan) )
+			return 0 ;
+		channels |= 1u << chan ;
+	}
+
+	// Smallest divider that fits the period into 16 bits
+	for ( pre = 0 ; pre <= PWM_SYNC_MAX_PRE ; pre++ )
+	{
+		period = (VARIANT_MCK >> pre) / frequency ;
+		if ( period <= PWM_SYNC_MAX_PERIOD )
+			break ;
+	}
+	if ( pre > PWM_SYNC_MAX_PRE || period < 2 )
+		return 0 ;
+
+	pwmSyncEnd() ;
+	pmc_enable_periph_clk( PWM_INTERFACE_ID ) ;
+
+	// Channels only take a new mode while disabled. The group shares the
+	// counter of channel 0, all get the same settings anyway.
+	PWM_INTERFACE->PWM_DIS = channels ;
+	while ( (PWM_INTERFACE->PWM_SR & channels) != 0 )
+		;
+	for ( i = 0 ; i < PWMCH_NUM_NUMBER ; i++ )
+	{
+		if ( (channels & (1u << i)) == 0 )
+			continue ;
+		PWM_INTERFACE->PWM_CH_NUM[i].PWM_CMR = pre ;
+		PWM_INTERFACE->PWM_CH_NUM[i].PWM_CPRD = period ;
+		PWM_INTERFACE->PWM_CH_NUM[i].PWM_CDTY = 0 ;
+	}
+
+	for ( i = 0 ; i < count ; i++ )
+	{
+		uint32_t ulPin = pins[i] ;
+		PIO_Configure( g_APinDescription[ulPin].pPort,
+				g_APinDescription[ulPin].ulPinType,
+				g_APinDescription[ulPin].ulPin,
+				g_APinDescription[ulPin].ulPinConfiguration ) ;
+		g_pinStatus[ulPin] = (g_pinStatus[ulPin] & 0xF0) | PIN_STATUS_PWM ;
+		syncPins[i] = g_APinDescription[ulPin].ulPWMChannel ;
+		syncPinNumbers[i] = ulPin ;
+	}
+	syncChannels = channels ;
+	syncCount = count ;
+
+	// Updates are written by hand and unlocked with UPDULOCK
+	PWMC_ConfigureSyncChannel( PWM_INTERFACE, channels, PWM_SCM_UPDM_MODE0, 0, 0 ) ;
+	PWM_INTERFACE->PWM_SCUP = PWM_SCUP_UPR( 0 ) ;
+	// Enabling channel 0 starts the whole group
+	PWM_INTERFACE->PWM_ENA = PWM_ENA_CHID0 ;
+	return period ;
+}
+
+void pwmSyncWrite( const uint16_t *duty )
+{
+	uint32_t i ;
+
+	if ( syncChannels == 0 || streamBuffer != NULL )
+		return ;
+
+	while ( (PWM_INTERFACE->PWM_SCUC & PWM_SCUC_UPDULOCK) != 0 )
+		;
+	for ( i = 0 ; i < syncCount ; i++ )
+		PWM_INTERFACE->PWM_CH_NUM[syncPins[i]].PWM_CDTYUPD = duty[i] ;
+	PWM_INTERFACE->PWM_SCUC = PWM_SCUC_UPDULOCK ;
+}
+
+static void pwmSyncStreamHandler( void )
+{
+	if ( (PWM_INTERFACE->PWM_ISR2 & PWM_ISR2_ENDTX) == 0 )
+		return ;
+
+	// The PDC has moved on to the other half, the one it left is free.
+	// It is filled and queued again, after the half now being sent.
+	uint16_t *done = streamBuffer ;
+	if ( PWM_INTERFACE->PWM_TPR - (uint32_t)streamBuffer < streamHalf * sizeof(uint16_t) )
+		done += streamHalf ;
+
+	if ( streamCallback )
+		streamCallback( done, streamHalf ) ;
+	PWM_INTERFACE->PWM_TNPR = (uint32_t)done ;
+	PWM_INTERFACE->PWM_TNCR = streamHalf ;
+}
+
+uint32_t pwmSyncStart( uint16_t *buffer, uint32_t size, uint32_t updatePeriod,
+                       void (*callback)(uint16_t *values, uint32_t count) )
+{
+	if ( syncChannels == 0 || buffer == NULL || updatePeriod == 0 || updatePeriod > 16 )
+		return 0 ;
+
+	// Halves hold whole rows, channel 0 included
+	uint32_t row = syncCount + 1 ;
+	uint32_t half = (size / 2) / row * row ;
+	if ( half == 0 )
+		return 0 ;
+
+	pwmSyncStop() ;
+
+	streamBuffer = buffer ;
+	streamHalf = half ;
+	streamCallback = callback ;
+	if ( callback )
+	{
+		callback( buffer, half ) ;
+		callback( buffer + half, half ) ;
+	}
+
+	// The PDC writes one row every update period, the channels take it
+	// over together
+	PWM_INTERFACE->PWM_SCUPUPD = PWM_SCUP_UPR( updatePeriod - 1 ) ;
+	PWM_INTERFACE->PWM_PTCR = PERIPH_PTCR_TXTDIS ;
+	PWM_INTERFACE->PWM_TPR = (uint32_t)buffer ;
+	PWM_INTERFACE->PWM_TCR = half ;
+	PWM_INTERFACE->PWM_TNPR = (uint32_t)(buffer + half) ;
+	PWM_INTERFACE->PWM_TNCR = half ;
+	PWMC_ConfigureSyncChannel( PWM_INTERFACE, syncChannels, PWM_SCM_UPDM_MODE2, 0, 0 ) ;
+	PWM_INTERFACE->PWM_PTCR = PERIPH_PTCR_TXTEN ;
+	pwmAttachInterrupt( pwmSyncStreamHandler ) ;
+	PWM_INTERFACE->PWM_IER2 = PWM_IER2_ENDTX ;
+	return 1 ;
+}
+
+void pwmSyncStop( void )
+{
+	if ( streamBuffer == NULL )
+		return ;
+
+	pwmDetachInterrupt() ;
+	PWM_INTERFACE->PWM_PTCR = PERIPH_PTCR_TXTDIS ;
+	PWMC_ConfigureSyncChannel( PWM_INTERFACE, syncChannels, PWM_SCM_UPDM_MODE0, 0, 0 ) ;
+	PWM_INTERFACE->PWM_SCUPUPD = PWM_SCUP_UPR( 0 ) ;
+	streamBuffer = NULL ;
+}
+
+void pwmSyncEnd( void )
+{
+	uint32_t i ;
+
+	if ( syncChannels == 0 )
+		return ;
+
+	pwmSyncStop() ;
+	PWM_INTERFACE->PWM_DIS = syncChannels ;
+	while ( (PWM_INTERFACE->PWM_SR & syncChannels) != 0 )
+		;
+	PWMC_ConfigureSyncChannel( PWM_INTERFACE, 0, PWM_SCM_UPDM_MODE0, 0, 0 ) ;
+
+	// Let analogWrite() set the pins up again
+	for ( i = 0 ; i < syncCount ; i++ )
+		g_pinStatus[syncPinNumbers[i]] &= 0xF0 ;
+	syncChannels = 0 ;
+	syncCount = 0 ;
+}
@@ -0,0 +1,167 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef _WIRING_PWM_
+#define _WIRING_PWM_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * \brief Registers the function called from PWM_Handler, the one who takes
+ * the PWM controller over enables the interrupts it needs in PWM_IER1/IER2.
+ *
+ * \param callback Function called in interrupt context.
+ */
+extern void pwmAttachInterrupt( void (*callback)(void) ) ;
+
+/*
+ * \brief Disables all PWM interrupts and removes the callback.
+ */
+extern void pwmDetachInterrupt( void ) ;
+
+// pwmConfigure() flags
+#define PWM_CENTER_ALIGNED  (1 << 0)
+#define PWM_INVERTED        (1 << 1)
+#define PWM_COMPLEMENTARY   (1 << 2)
+
+/*
+ * \brief Sets up a PWM pin with its own frequency, at the finest resolution
+ * that frequency allows, instead of the fixed PWM_FREQUENCY/TC_FREQUENCY and
+ * 8 bits of analogWrite(). The duty cycle starts at 0, pwmWrite() sets it.
+ *
+ * Works on the PWM pins (6 to 9) and the timer pins (2 to 5, 10 to 13). The
+ * two timer outputs on one TC channel (pins 2 and 13, 3 and 10, 4 and 5,
+ * 11 and 12) share one counter: while the other output runs, through
+ * pwmConfigure() or analogWrite(), the pin can only be set up with the same
+ * frequency and PWM_CENTER_ALIGNED. A later analogWrite() on either pin sets
+ * the channel up again for both.
+ *
+ * \param ulPin
+ * \param frequency PWM frequency in Hz.
+ * \param flags Any of
+ * PWM_CENTER_ALIGNED: the active time is centered in the period,
+ * PWM_INVERTED: the pin is low while active,
+ * PWM_COMPLEMENTARY: the high side output of the same PWM channel, active
+ * while the pin is not, is enabled too and dead times can be inserted with
+ * pwmSetDeadTime(). Pin 8 pairs with pin 44, pin 7 with pin 45.
+ *
+ * \return The period in clock ticks, i.e. the duty cycle of a pin that is
+ * always active, 0 if the pin or the parameters are invalid.
+ */
+extern uint32_t pwmConfigure( uint32_t ulPin, uint32_t frequency, uint32_t flags ) ;
+
+/*
+ * \brief Sets the duty cycle of a pin set up by pwmConfigure(). On PWM pins it
+ * takes effect at the start of the next period. Timer pins have no buffered
+ * compare, the write waits until the counter is clear of the old and new
+ * values (less than one period) and takes effect in the current period if
+ * the new compare is still ahead, in the next one otherwise.
+ *
+ * \param ulPin
+ * \param duty Active time in clock ticks, from 0 to the period. Larger
+ * values are clamped to the period.
+ */
+extern void pwmWrite( uint32_t ulPin, uint32_t duty ) ;
+
+/*
+ * \brief Sets the dead times of a complementary pair, so that both outputs
+ * are never active together. Call it after pwmWrite(), the dead times
+ * have to fit in the active time of each output.
+ *
+ * \param ulPin Pin set up with PWM_COMPLEMENTARY.
+ * \param timeH Delay in clock ticks of the rising edge of the high side
+ * output (pin 44 or 45).
+ * \param timeL Delay in clock ticks of the rising edge of the pin.
+ *
+ * \return 1 on success, 0 if the pin is not complementary or the times are
+ * too long.
+ */
+extern uint32_t pwmSetDeadTime( uint32_t ulPin, uint32_t timeH, uint32_t timeL ) ;
+
+/*
+ * \brief Runs PWM pins as synchronous channels: they share one counter, so
+ * their periods start together, and new duty cycles take effect on all of
+ * them at the same period boundary. PWM channel 0 is the time base and is
+ * part of the group without being routed to a pin.
+ *
+ * The PWM clock is the master clock divided by a power of two, chosen for
+ * the finest duty cycle steps. Pins of the group must not be used by
+ * analogWrite() until pwmSyncEnd(). Other PWM pins can be, but their first
+ * analogWrite() rewrites the mode of channel 0 (PWMC_ConfigureChannel()
+ * does), so start them before the group.
+ *
+ * \param pins PWM pins (6 to 9).
+ * \param count Number of pins.
+ * \param frequency PWM frequency in Hz.
+ *
+ * \return The period in clock ticks, i.e. the duty cycle of a pin that is
+ * always high, 0 if the parameters are invalid.
+ */
+extern uint32_t pwmSyncBegin( const uint32_t *pins, uint32_t count, uint32_t frequency ) ;
+
+/*
+ * \brief Sets the duty cycles of all pins of the group at once. They are
+ * applied together at the start of the next period; if the previous update
+ * is still pending, waits for it.
+ *
+ * \param duty One value per pin, in the order of pins passed to
+ * pwmSyncBegin(), from 0 to the period.
+ */
+extern void pwmSyncWrite( const uint16_t *duty ) ;
+
+/*
+ * \brief Feeds duty cycles to the group from a table with the PDC, one row
+ * every updatePeriod PWM periods.
+ *
+ * A row holds a value for channel 0 (ignored, only the time base) followed
+ * by one value per pin in ascending PWM channel order: pin 9 (channel 4),
+ * 8, 7, 6. The buffer is used as two halves: callback is called with each
+ * half to fill, both before the output starts and then every time the PDC
+ * has finished one half. Without callback the table is repeated over and
+ * over.
+ *
+ * \param buffer Holds the rows.
+ * \param size Size of buffer in values, at least two rows.
+ * \param updatePeriod PWM periods per row, 1 to 16.
+ * \param callback Called with a half to fill and its number of values, in
+ * interrupt context once the output runs.
+ *
+ * \return 1 on success, 0 if the parameters are invalid or there is no
+ * group.
+ */
+extern uint32_t pwmSyncStart( uint16_t *buffer, uint32_t size, uint32_t updatePeriod,
+                              void (*callback)(uint16_t *values, uint32_t count) ) ;
+
+/*
+ * \brief Stops the PDC, the pins keep the last duty cycles.
+ */
+extern void pwmSyncStop( void ) ;
+
+/*
+ * \brief Stops the synchronous channels and releases the group.
+ */
+extern void pwmSyncEnd( void ) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WIRING_PWM_ */
@@ -0,0 +1,294 @@
+/*
+  Copyright (c) 2015 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "Arduino.h"
+
+// Largest period of a PWM channel, and the largest master clock divider
+#define PWM_MAX_PERIOD      65535
+#define PWM_MAX_PRE         10
+
+// pwmConfigure() flags of each TC output (TIOA0, TIOB0, TIOA1...),
+// pwmWrite() needs them
+static uint8_t tcFlags[18] ;
+
+// The high side outputs on the board, for complementary pairs
+static const struct { uint32_t ulPin ; uint32_t ulChannel ; uint32_t ulMask ; } pwmHighPins[] = {
+	{ 44, 5, PIO_PC19B_PWMH5 },
+	{ 45, 6, PIO_PC18B_PWMH6 },
+} ;
+
+// Counter ticks needed to check TC_CV and write the new compare value
+#define PWM_TC_MARGIN       16
+
+static Tc *tcOf( uint32_t tcChannel )
+{
+	return tcChannel < 3 ? TC0 : (tcChannel < 6 ? TC1 : TC2) ;
+}
+
+// Whether a pin drives the TC output (TIOA0, TIOB0, TIOA1...) as PWM
+static uint32_t tcOutputUsed( uint32_t channel )
+{
+	for ( uint32_t i = 0 ; i < PINS_COUNT ; i++ )
+		if ( (g_APinDescription[i].ulPinAttribute & PIN_ATTR_TIMER) == PIN_ATTR_TIMER &&
+				(uint32_t)g_APinDescription[i].ulTCChannel == channel &&
+				(g_pinStatus[i] & 0xF) == PIN_STATUS_PWM )
+			return 1 ;
+	return 0 ;
+}
+
+// RA/RB and the actions in TC_CMR are not double buffered. They are
+// written while the counter is clear of both the old and the new compare
+// value, so that exactly one of them matches in the current period. Center
+// aligned also needs the counter on its way up, the toggles would swap
+// otherwise.
+static void pwmWriteTC( TcChannel *ch, uint32_t onB, uint32_t compare, uint32_t actionsMask, uint32_t actions, uint32_t center )
+{
+	uint32_t old = onB ? ch->TC_RB : ch->TC_RA ;
+	uint32_t low = old < compare ? old : compare ;
+	uint32_t high = old < compare ? compare : old ;
+	uint32_t period = ch->TC_RC ;
+	uint32_t primask ;
+
+	// A stopped counter, or no room outside the window: write right away
+	uint32_t wait = (ch->TC_SR & TC_SR_CLKSTA) && (low >= PWM_TC_MARGIN || high + PWM_TC_MARGIN < period) ;
+
+	for ( ;; )
+	{
+		primask = __get_PRIMASK() ;
+		__disable_irq() ;
+		if ( !wait )
+			break ;
+		uint32_t cv = ch->TC_CV ;
+		if ( (cv + PWM_TC_MARGIN <= low || cv > high + PWM_TC_MARGIN) && (!center || ch->TC_CV > cv) )
+			break ;
+		__set_PRIMASK( primask ) ;
+	}
+
+	if ( onB )
+		ch->TC_RB = compare ;
+	else
+		ch->TC_RA = compare ;
+	ch->TC_CMR = (ch->TC_CMR & ~actionsMask) | actions ;
+	__set_PRIMASK( primask ) ;
+}
+
+uint32_t pwmConfigure( uint32_t ulPin, uint32_t frequency, uint32_t flags )
+{
+	uint32_t center = (flags & PWM_CENTER_ALIGNED) ? 2 : 1 ;
+	uint32_t pre, period = 0 ;
+	uint32_t i ;
+
+	if ( ulPin >= PINS_COUNT || frequency == 0 )
+		return 0 ;
+	uint32_t attr = g_APinDescription[ulPin].ulPinAttribute ;
+
+	if ( (attr & PIN_ATTR_PWM) == PIN_ATTR_PWM )
+	{
+		uint32_t chan = g_APinDescription[ulPin].ulPWMChannel ;
+		// Taken by pwmSyncBegin()
+		if ( PWM_INTERFACE->PWM_SCM & (1u << chan) )
+			return 0 ;
+
+		// Smallest divider that fits the period into 16 bits
+		for ( pre = 0 ; pre <= PWM_MAX_PRE ; pre++ )
+		{
+			period = (VARIANT_MCK >> pre) / (frequency * center) ;
+			if ( period <= PWM_MAX_PERIOD )
+				break ;
+		}
+		if ( pre > PWM_MAX_PRE || period < 2 )
+			return 0 ;
+
+		uint32_t high = 0 ;
+		if ( flags & PWM_COMPLEMENTARY )
+		{
+			for ( i = 0 ; i < sizeof(pwmHighPins) / sizeof(pwmHighPins[0]) ; i++ )
+				if ( pwmHighPins[i].ulChannel == chan )
+					high = i + 1 ;
+			if ( high == 0 )
+				return 0 ;
+		}
+
+		if ( (g_pinStatus[ulPin] & 0xF) != PIN_STATUS_PWM )
+			pmc_enable_periph_clk( PWM_INTERFACE_ID ) ;
+
+		// Waits for the end of the period if the channel runs
+		PWMC_ConfigureChannelExt( PWM_INTERFACE, chan, pre,
+				(flags & PWM_CENTER_ALIGNED) ? PWM_CMR_CALG : 0,
+				(flags & PWM_INVERTED) ? PWM_CMR_CPOL : 0,
+				0, (flags & PWM_COMPLEMENTARY) ? PWM_CMR_DTE : 0, 0, 0 ) ;
+		PWMC_SetPeriod( PWM_INTERFACE, chan, period ) ;
+		PWMC_SetDutyCycle( PWM_INTERFACE, chan, 0 ) ;
+		PWMC_SetDeadTime( PWM_INTERFACE, chan, 0, 0 ) ;
+
+		PIO_Configure( g_APinDescription[ulPin].pPort,
+				g_APinDescription[ulPin].ulPinType,
+				g_APinDescription[ulPin].ulPin,
+				g_APinDescription[ulPin].ulPinConfiguration ) ;
+		g_pinStatus[ulPin] = (g_pinStatus[ulPin] & 0xF0) | PIN_STATUS_PWM ;
+		if ( high )
+		{
+			PIO_Configure( PIOC, PIO_PERIPH_B, pwmHighPins[high - 1].ulMask, PIO_DEFAULT ) ;
+			g_pinStatus[pwmHighPins[high - 1].ulPin] = (g_pinStatus[pwmHighPins[high - 1].ulPin] & 0xF0) | PIN_STATUS_PWM ;
+		}
+
+		PWMC_EnableChannel( PWM_INTERFACE, chan ) ;
+		return period ;
+	}
+
+	if ( (attr & PIN_ATTR_TIMER) == PIN_ATTR_TIMER )
+	{
+		// Both outputs of a TC channel share its counter, no dead time
+		if ( flags & PWM_COMPLEMENTARY )
+			return 0 ;
+
+		uint32_t channel = g_APinDescription[ulPin].ulTCChannel ;
+		uint32_t tcChannel = channel / 2 ;
+		Tc *chTC = tcOf( tcChannel ) ;
+		uint32_t chNo = tcChannel % 3 ;
+
+		// 32 bit counter on MCK/2
+		period = (VARIANT_MCK / 2) / (frequency * center) ;
+		if ( period < 2 )
+			return 0 ;
+
+		TcChannel *ch = &chTC->TC_CHANNEL[chNo] ;
+		uint32_t mode = TC_CMR_TCCLKS_TIMER_CLOCK1 |
+			TC_CMR_WAVE |
+			((flags & PWM_CENTER_ALIGNED) ? TC_CMR_WAVSEL_UPDOWN_RC : TC_CMR_WAVSEL_UP_RC) |
+			TC_CMR_EEVT_XC0 ;
+		uint32_t actionsMsk = TC_CMR_ACPA_Msk | TC_CMR_ACPC_Msk | TC_CMR_AEEVT_Msk | TC_CMR_ASWTRG_Msk |
+			TC_CMR_BCPB_Msk | TC_CMR_BCPC_Msk | TC_CMR_BEEVT_Msk | TC_CMR_BSWTRG_Msk ;
+
+		pmc_enable_periph_clk( TC_INTERFACE_ID + tcChannel ) ;
+		// The other output of the channel may be running on the same
+		// counter, through analogWrite() or pwmConfigure(). It is kept
+		// if it runs at this period and alignment, any other setup would
+		// change it under its feet.
+		uint32_t shared = (ch->TC_SR & TC_SR_CLKSTA) && tcOutputUsed( channel ^ 1 ) ;
+		if ( shared && ((ch->TC_CMR & ~actionsMsk) != mode || ch->TC_RC != period) )
+			return 0 ;
+		if ( !shared )
+		{
+			TC_Configure( chTC, chNo, mode ) ;
+			TC_SetRC( chTC, chNo, period ) ;
+		}
+		tcFlags[channel] = flags ;
+		// analogWrite() sets the channel up again on its next write
+		analogOutputReleaseTC( tcChannel ) ;
+
+		PIO_Configure( g_APinDescription[ulPin].pPort,
+				g_APinDescription[ulPin].ulPinType,
+				g_APinDescription[ulPin].ulPin,
+				g_APinDescription[ulPin].ulPinConfiguration ) ;
+		g_pinStatus[ulPin] = (g_pinStatus[ulPin] & 0xF0) | PIN_STATUS_PWM ;
+
+		pwmWrite( ulPin, 0 ) ;
+		if ( !shared )
+			TC_Start( chTC, chNo ) ;
+		return period ;
+	}
+
+	return 0 ;
+}
+
+void pwmWrite( uint32_t ulPin, uint32_t duty )
+{
+	if ( ulPin >= PINS_COUNT )
+		return ;
+	uint32_t attr = g_APinDescription[ulPin].ulPinAttribute ;
+
+	if ( (attr & PIN_ATTR_PWM) == PIN_ATTR_PWM )
+	{
+		uint32_t chan = g_APinDescription[ulPin].ulPWMChannel ;
+		uint32_t period = PWM_INTERFACE->PWM_CH_NUM[chan].PWM_CPRD ;
+
+		if ( duty > period )
+			duty = period ;
+		PWMC_SetDutyCycle( PWM_INTERFACE, chan, duty ) ;
+		return ;
+	}
+
+	if ( (attr & PIN_ATTR_TIMER) == PIN_ATTR_TIMER )
+	{
+		uint32_t channel = g_APinDescription[ulPin].ulTCChannel ;
+		uint32_t tcChannel = channel / 2 ;
+		Tc *chTC = tcOf( tcChannel ) ;
+		uint32_t chNo = tcChannel % 3 ;
+		uint32_t flags = tcFlags[channel] ;
+		uint32_t period = chTC->TC_CHANNEL[chNo].TC_RC ;
+		uint32_t compare, onTop, onCompare ;
+
+		if ( duty > period )
+			duty = period ;
+
+		// Edge aligned: active from RC (the start) to the compare value.
+		// Center aligned: the compare value toggles the pin on the way up
+		// and again on the way down, RC forces the active level at the top
+		// to keep the two in step.
+		uint32_t set = (flags & PWM_INVERTED) ? TC_CMR_ACPA_CLEAR : TC_CMR_ACPA_SET ;
+		uint32_t clear = (flags & PWM_INVERTED) ? TC_CMR_ACPA_SET : TC_CMR_ACPA_CLEAR ;
+		if ( flags & PWM_CENTER_ALIGNED )
+		{
+			compare = period - duty ;
+			onCompare = TC_CMR_ACPA_TOGGLE ;
+		}
+		else
+		{
+			compare = duty ;
+			onCompare = clear ;
+		}
+		onTop = set << (TC_CMR_ACPC_Pos - TC_CMR_ACPA_Pos) ;
+
+		// A duty cycle of 0 never goes active
+		if ( duty == 0 )
+		{
+			onCompare = clear ;
+			onTop = clear << (TC_CMR_ACPC_Pos - TC_CMR_ACPA_Pos) ;
+		}
+
+		if ( (channel & 1) == 0 )
+			pwmWriteTC( &chTC->TC_CHANNEL[chNo], 0, compare, TC_CMR_ACPA_Msk | TC_CMR_ACPC_Msk,
+				onCompare | onTop, flags & PWM_CENTER_ALIGNED ) ;
+		else
+			// Same actions on the B output, on RB and RC
+			pwmWriteTC( &chTC->TC_CHANNEL[chNo], 1, compare, TC_CMR_BCPB_Msk | TC_CMR_BCPC_Msk,
+				((onCompare >> TC_CMR_ACPA_Pos) << TC_CMR_BCPB_Pos) |
+				((onTop >> TC_CMR_ACPC_Pos) << TC_CMR_BCPC_Pos), flags & PWM_CENTER_ALIGNED ) ;
+	}
+}
+
+uint32_t pwmSetDeadTime( uint32_t ulPin, uint32_t timeH, uint32_t timeL )
+{
+	if ( ulPin >= PINS_COUNT || (g_APinDescription[ulPin].ulPinAttribute & PIN_ATTR_PWM) != PIN_ATTR_PWM )
+		return 0 ;
+
+	uint32_t chan = g_APinDescription[ulPin].ulPWMChannel ;
+	PwmCh_num *ch = &PWM_INTERFACE->PWM_CH_NUM[chan] ;
+	if ( (ch->PWM_CMR & PWM_CMR_DTE) == 0 )
+		return 0 ;
+
+	// Dead times can not exceed the time either output is active
+	uint32_t duty = ch->PWM_CDTY ;
+	if ( timeH > ch->PWM_CPRD - duty || timeL > duty )
+		return 0 ;
+
+	PWMC_SetDeadTime( PWM_INTERFACE, chan, timeH, timeL ) ;
+	return 1 ;
+}
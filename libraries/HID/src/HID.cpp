@@ -20,6 +20,12 @@
 
 #if defined(USBCON)
 
+extern uint32_t EndPoints[];
+
+// Queue entries: 16 bit length, report, padding to an even size.
+// This length marks the rest of the queue as unused, next entry at 0.
+#define HID_QUEUE_WRAP 0xFFFF
+
 HID_& HID()
 {
 	static HID_ obj;
@@ -29,10 +35,25 @@ HID_& HID()
 int HID_::getInterface(uint8_t* interfaceCount)
 {
 	*interfaceCount += 1; // uses 1
+
+	// The speed is known by now, size the endpoint for it before
+	// SET_CONFIGURATION sets it up
+	uint16_t packetSize = PacketSize();
+	ConfigureEndpoint();
+
+	// bInterval is 2^(n-1) microframes at high speed, n frames at full speed
+	uint8_t bInterval = 1;
+	if (USBD_IsHighSpeed()) {
+		while (bInterval < 16 && (125UL << bInterval) <= interval)
+			bInterval++;
+	} else {
+		bInterval = constrain(interval / 1000, 1, 255);
+	}
+
 	HIDDescriptor hidInterface = {
 		D_INTERFACE(pluggedInterface, 1, USB_DEVICE_CLASS_HUMAN_INTERFACE, HID_SUBCLASS_NONE, HID_PROTOCOL_NONE),
 		D_HIDREPORT(descriptorSize),
-		D_ENDPOINT(USB_ENDPOINT_IN(pluggedEndpoint), USB_ENDPOINT_TYPE_INTERRUPT, 0x40, 0x01)
+		D_ENDPOINT(USB_ENDPOINT_IN(pluggedEndpoint), USB_ENDPOINT_TYPE_INTERRUPT, packetSize, bInterval)
 	};
 	return USBD_SendControl(0, &hidInterface, sizeof(hidInterface));
 }
@@ -81,12 +102,141 @@ void HID_::AppendDescriptor(HIDSubDescriptor *node)
 	descriptorSize += node->length;
 }
 
+// Queue the report, it is sent on one of the next polls of the host.
+// Only waits if the queue is full, and not at all with interrupts
+// disabled or from an interrupt handler (the report is dropped then).
 int HID_::SendReport(uint8_t id, const void* data, int len)
 {
-	uint8_t p[64];
-	p[0] = id;
-	memcpy(&p[1], data, len);
-	return USBD_Send(pluggedEndpoint, p, len+1);
+	if (len < 0 || len + 1 > PacketSize() || !USBDevice.configured())
+		return -1;
+
+	while (!QueueReport(id, data, len)) {
+		if (!USBDevice.configured() || __get_PRIMASK() || __get_IPSR())
+			return -1;
+	}
+	USBD_EnableSendInterrupt(pluggedEndpoint);
+	return len + 1;
+}
+
+bool HID_::QueueReport(uint8_t id, const void* data, uint16_t len)
+{
+	// The queue never wraps inside an entry, so the interrupt can send
+	// straight from it. At least 2 bytes stay free at the end for the
+	// wrap marker, and head never catches up with tail.
+	uint16_t size = (2 + 1 + len + 1) & ~1;
+	bool queued = false;
+
+	irqflags_t flags = cpu_irq_save();
+	uint16_t head = queueHead;
+	uint16_t tail = queueTail;
+	uint16_t pos = head;
+	if (head >= tail) {
+		if (head + size + 2 > HID_REPORT_QUEUE_SIZE) {
+			pos = 0;
+			if (size >= tail)
+				goto out;
+		}
+	} else if (size >= tail - head) {
+		goto out;
+	}
+
+	if (pos != head)
+		*(uint16_t*)&queue[head] = HID_QUEUE_WRAP;
+	*(uint16_t*)&queue[pos] = len + 1;
+	queue[pos + 2] = id;
+	memcpy(&queue[pos + 3], data, len);
+	queueHead = pos + size;
+	queued = true;
+out:
+	cpu_irq_restore(flags);
+	return queued;
+}
+
+bool HID_::handleEndpoint(uint8_t ep)
+{
+	if (ep != pluggedEndpoint)
+		return false;
+
+	uint16_t tail = queueTail;
+	if (tail != queueHead && *(uint16_t*)&queue[tail] == HID_QUEUE_WRAP)
+		tail = 0;
+	if (tail == queueHead) {
+		USBD_DisableSendInterrupt(ep);
+		queueTail = tail;
+		return true;
+	}
+
+	// Fills one free bank, the interrupt comes again for the next report
+	uint16_t len = *(uint16_t*)&queue[tail];
+	if (USBD_SendPacket(ep, &queue[tail + 2], len) != (uint32_t)-1)
+		tail += (2 + len + 1) & ~1;
+	queueTail = tail;
+	return true;
+}
+
+void HID_::SetInterval(uint32_t microseconds)
+{
+	interval = constrain(microseconds, 125, 255000);
+}
+
+void HID_::SetMaxPacketSize(uint16_t size)
+{
+	maxPacketSize = constrain(size, 8, 1024);
+	ConfigureEndpoint();
+}
+
+uint16_t HID_::PacketSize(void)
+{
+	// Full speed interrupt endpoints are limited to 64 bytes
+	if (!USBD_IsHighSpeed())
+		return min(maxPacketSize, 64);
+	return maxPacketSize;
+}
+
+void HID_::ConfigureEndpoint(void)
+{
+	uint16_t packetSize = PacketSize();
+	uint32_t epSize = 0;
+	while ((8U << epSize) < packetSize)
+		epSize++;
+
+	// A single bank above 512 bytes keeps DPRAM for the CDC endpoints
+	epType[0] = (epSize << UOTGHS_DEVEPTCFG_EPSIZE_Pos) |
+				UOTGHS_DEVEPTCFG_EPDIR_IN |
+				UOTGHS_DEVEPTCFG_EPTYPE_INTRPT |
+				(packetSize > 512 ? UOTGHS_DEVEPTCFG_EPBK_1_BANK : UOTGHS_DEVEPTCFG_EPBK_2_BANK) |
+				UOTGHS_DEVEPTCFG_NBTRANS_1_TRANS |
+				UOTGHS_DEVEPTCFG_ALLOC;
+	EndPoints[pluggedEndpoint] = epType[0];
+}
+
+bool HID_::GetReport(USBSetup& setup)
+{
+	// Without a callback answer with an empty report, as before
+	if (!getReportCallback)
+		return true;
+
+	uint8_t data[HID_CONTROL_REPORT_SIZE];
+	uint16_t len = getReportCallback(setup.wValueH, setup.wValueL, data, min(setup.wLength, sizeof(data)));
+	USBD_SendControl(0, data, min(len, sizeof(data)));
+	return true;
+}
+
+bool HID_::SetReport(USBSetup& setup)
+{
+	if (!setReportCallback)
+		return false;
+
+	// USBD_RecvControl() handles one packet of the data stage at a time
+	uint8_t data[HID_CONTROL_REPORT_SIZE];
+	uint16_t length = setup.wLength;
+	if (length > sizeof(data))
+		return false;
+	for (uint16_t i = 0; i < length; i += 64)
+		USBD_RecvControl(data + i, min(length - i, 64));
+
+	setReportCallback(setup.wValueH, setup.wValueL, data, length);
+	return true;
 }
 
 bool HID_::setup(USBSetup& setup)
@@ -101,8 +251,7 @@ bool HID_::setup(USBSetup& setup)
 	if (requestType == REQUEST_DEVICETOHOST_CLASS_INTERFACE)
 	{
 		if (request == HID_GET_REPORT) {
-			// TODO: HID_GetReport();
-			return true;
+			return GetReport(setup);
 		}
 		if (request == HID_GET_PROTOCOL) {
 			// TODO: Send8(protocol);
@@ -125,15 +274,8 @@ bool HID_::setup(USBSetup& setup)
 			idle = setup.wValueL;
 			return true;
 		}
-		if (request == HID_SET_REPORT)
-		{
-			//uint8_t reportID = setup.wValueL;
-			//uint16_t length = setup.wLength;
-			//uint8_t data[length];
-			// Make sure to not read more data than USB_EP_SIZE.
-			// You can read multiple times through a loop.
-			// The first byte (may!) contain the reportID on a multreport.
-			//USB_RecvControl(data, length);
+		if (request == HID_SET_REPORT) {
+			return SetReport(setup);
 		}
 	}
 
@@ -142,7 +284,10 @@ bool HID_::setup(USBSetup& setup)
 
 HID_::HID_(void) : PluggableUSBModule(1, 1, epType),
                    rootNode(NULL), descriptorSize(0),
-                   protocol(1), idle(1)
+                   protocol(1), idle(1),
+                   maxPacketSize(64), interval(125),
+                   setReportCallback(NULL), getReportCallback(NULL),
+                   queueHead(0), queueTail(0)
 {
 	epType[0] = EP_TYPE_INTERRUPT_IN;
 	PluggableUSB().plug(this);
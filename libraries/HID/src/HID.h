@@ -54,6 +54,28 @@
 #define HID_BOOT_PROTOCOL	0
 #define HID_REPORT_PROTOCOL	1
 
+// HID Request Type HID1.11 Page 51 7.2.1 Get_Report Request
+#define HID_REPORT_TYPE_INPUT   1
+#define HID_REPORT_TYPE_OUTPUT  2
+#define HID_REPORT_TYPE_FEATURE 3
+
+// Bytes of queued reports, each report takes its size plus 2 rounded up
+// to even. Holds at least one report of the largest packet size.
+#ifndef HID_REPORT_QUEUE_SIZE
+#define HID_REPORT_QUEUE_SIZE 2048
+#endif
+
+// Largest output or feature report handled on the control endpoint
+#ifndef HID_CONTROL_REPORT_SIZE
+#define HID_CONTROL_REPORT_SIZE 256
+#endif
+
+// Output or feature report received through SET_REPORT. With report IDs
+// the first byte of data is the report ID.
+typedef void (*HIDSetReportCallback)(uint8_t type, uint8_t id, const uint8_t* data, uint16_t length);
+// Feature or input report requested through GET_REPORT, returns its length
+typedef uint16_t (*HIDGetReportCallback)(uint8_t type, uint8_t id, uint8_t* data, uint16_t maxLength);
+
 typedef struct
 {
   uint8_t len;      // 9
@@ -91,14 +113,32 @@ public:
   int SendReport(uint8_t id, const void* data, int len);
   void AppendDescriptor(HIDSubDescriptor* node);
 
+  // Polling interval in microseconds, 125us steps (powers of two) at high
+  // speed, 1ms steps at full speed. Takes effect at the next enumeration.
+  void SetInterval(uint32_t microseconds);
+  // Interrupt endpoint size, 8 up to 1024 bytes at high speed (64 at full
+  // speed). Takes effect at the next enumeration.
+  void SetMaxPacketSize(uint16_t size);
+
+  void OnSetReport(HIDSetReportCallback callback) { setReportCallback = callback; }
+  void OnGetReport(HIDGetReportCallback callback) { getReportCallback = callback; }
+
 protected:
   // Implementation of the PluggableUSBModule
   int getInterface(uint8_t* interfaceCount);
   int getDescriptor(USBSetup& setup);
   bool setup(USBSetup& setup);
   uint8_t getShortName(char* name);
+  bool handleEndpoint(uint8_t ep);
 
 private:
+  bool QueueReport(uint8_t id, const void* data, uint16_t len);
+  bool SetReport(USBSetup& setup);
+  bool GetReport(USBSetup& setup);
+  // maxPacketSize, limited to what the current bus speed allows
+  uint16_t PacketSize(void);
+  void ConfigureEndpoint(void);
+
   uint32_t epType[1];
 
   HIDSubDescriptor* rootNode;
@@ -106,6 +146,17 @@ private:
 
   uint8_t protocol;
   uint8_t idle;
+
+  uint16_t maxPacketSize;
+  uint32_t interval;
+
+  HIDSetReportCallback setReportCallback;
+  HIDGetReportCallback getReportCallback;
+
+  // Reports are sent from the endpoint interrupt as soon as a bank is free
+  uint8_t queue[HID_REPORT_QUEUE_SIZE] __attribute__((aligned(2)));
+  volatile uint16_t queueHead;
+  volatile uint16_t queueTail;
 };
 
 // Replacement for global singleton.
@@ -0,0 +1,54 @@
+/*
+  I2S Sine Wave
+
+  Plays a 440 Hz tone on both channels of an I2S codec or DAC, 16 bit
+  at 44.1 kHz. The samples are computed in the callback, the DMA
+  controller sends them to the codec.
+
+  The circuit:
+  * BCLK - digital pin 23 (TK)
+  * LRCK - digital pin 24 (TF)
+  * DIN  - analog pin A0 (TD)
+  * The codec must generate its master clock itself (PLL or crystal)
+
+  This example code is in the public domain.
+*/
+
+#include <I2S.h>
+
+const float frequency = 440.0;
+const float amplitude = 8000.0;
+
+float phase = 0.0;
+float step;
+
+void fillBuffer(void *buf, size_t size) {
+  int16_t *samples = (int16_t *)buf;
+
+  for (size_t i = 0; i < size / sizeof(int16_t); i += 2) {
+    int16_t s = amplitude * sin(phase);
+    samples[i] = s;      // left
+    samples[i + 1] = s;  // right
+    phase += step;
+    if (phase >= TWO_PI)
+      phase -= TWO_PI;
+  }
+}
+
+void setup() {
+  Serial.begin(9600);
+
+  step = TWO_PI * frequency / 44100;
+  I2S.onTransmit(fillBuffer);
+  if (!I2S.begin(44100, 16, I2S_TX)) {
+    Serial.println("I2S setup failed");
+    return;
+  }
+  // The rate really generated differs slightly from the one asked for
+  step = TWO_PI * frequency / I2S.sampleRate();
+  Serial.print("Sample rate: ");
+  Serial.println(I2S.sampleRate());
+}
+
+void loop() {
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * I2S audio library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#include "I2S.h"
+
+// DMA controller channels, apart from the ones of SPI and SPISlave, and
+// the SSC hardware handshaking interfaces. RX gets the higher priority.
+#define I2S_DMAC_TX_CH		4
+#define I2S_DMAC_RX_CH		5
+#define I2S_DMAC_TX_PER		3
+#define I2S_DMAC_RX_PER		4
+
+static void I2S_TxHandler(void) {
+	I2S.onTxInterrupt();
+}
+
+static void I2S_RxHandler(void) {
+	I2S.onRxInterrupt();
+}
+
+I2SClass::I2SClass(Ssc *_ssc, uint32_t _id, void(*_initCb)(uint8_t)) :
+	ssc(_ssc), id(_id), initCb(_initCb), mode(0), bits(16),
+	txCallback(NULL), rxCallback(NULL)
+{
+	// Empty
+}
+
+bool I2SClass::begin(uint32_t _sampleRate, uint8_t _bitsPerSample, uint8_t _mode) {
+	if (_bitsPerSample < 8 || _bitsPerSample > 32 || (_mode & I2S_DUPLEX) == 0 || _sampleRate == 0)
+		return false;
+	// The bit clock divider is 12 bits wide
+	uint32_t bitClock = _sampleRate * 2 * _bitsPerSample;
+	if (bitClock > SystemCoreClock / 2 || bitClock < SystemCoreClock / (2 * 4095))
+		return false;
+
+	if (mode)
+		end();
+
+	bits = _bitsPerSample;
+	mode = _mode & I2S_DUPLEX;
+
+	initCb(mode);
+	pmc_enable_periph_clk(id);
+	pmc_enable_periph_clk(ID_DMAC);
+	DMAC->DMAC_GCFG = DMAC_GCFG_ARB_CFG_FIXED;
+	DMAC->DMAC_EN = DMAC_EN_ENABLE;
+
+	ssc_reset(ssc);
+	ssc_set_clock_divider(ssc, bitClock, SystemCoreClock);
+
+	// The transmitter generates the clocks, also when only receiving.
+	// The frame sync is as long as one sample, FSLEN has 4 bits and an
+	// extension for the upper ones.
+	ssc_i2s_set_transmitter(ssc, SSC_I2S_MASTER_OUT, 0, SSC_AUDIO_STERO, bits);
+	ssc->SSC_TFMR = (ssc->SSC_TFMR & ~(SSC_TFMR_FSLEN_Msk | SSC_TFMR_FSLEN_EXT_Msk)) |
+			SSC_TFMR_FSLEN((bits - 1) & 0xF) | SSC_TFMR_FSLEN_EXT((bits - 1) >> 4);
+
+	// The receiver runs on TK and starts with the transmitter. Data is
+	// shifted out on the falling edge and sampled on the rising one.
+	clock_opt_t rxClock;
+	data_frame_opt_t rxFrame;
+	memset(&rxClock, 0, sizeof(rxClock));
+	memset(&rxFrame, 0, sizeof(rxFrame));
+	rxClock.ul_cks = SSC_RCMR_CKS_TK;
+	rxClock.ul_cko = SSC_RCMR_CKO_NONE;
+	rxClock.ul_cki = SSC_RCMR_CKI;
+	rxClock.ul_ckg = SSC_RCMR_CKG_NONE;
+	rxClock.ul_start_sel = SSC_RCMR_START_TRANSMIT;
+	rxClock.ul_sttdly = 1;
+	rxFrame.ul_datlen = bits - 1;
+	rxFrame.ul_msbf = SSC_RFMR_MSBF;
+	rxFrame.ul_datnb = 1;
+	rxFrame.ul_fsos = SSC_RFMR_FSOS_NONE;
+	ssc_set_receiver(ssc, &rxClock, &rxFrame);
+
+	if (mode & I2S_RX)
+		startRx();
+	if (mode & I2S_TX)
+		startTx();
+	ssc_enable_tx(ssc);
+	return true;
+}
+
+void I2SClass::end(void) {
+	DMAC->DMAC_CHDR = (DMAC_CHDR_DIS0 << I2S_DMAC_TX_CH) | (DMAC_CHDR_DIS0 << I2S_DMAC_RX_CH);
+	dmacDetachInterrupt(I2S_DMAC_TX_CH);
+	dmacDetachInterrupt(I2S_DMAC_RX_CH);
+	ssc_disable_tx(ssc);
+	ssc_disable_rx(ssc);
+	pmc_disable_periph_clk(id);
+	mode = 0;
+}
+
+uint32_t I2SClass::sampleRate(void) {
+	uint32_t div = ssc->SSC_CMR & SSC_CMR_DIV_Msk;
+	if (div == 0)
+		return 0;
+	return SystemCoreClock / (2 * div * 2 * bits);
+}
+
+void I2SClass::onTransmit(void (*_callback)(void *, size_t)) {
+	txCallback = _callback;
+}
+
+void I2SClass::onReceive(void (*_callback)(const void *, size_t)) {
+	rxCallback = _callback;
+}
+
+uint32_t I2SClass::width(void) {
+	switch (unit()) {
+	case 1:
+		return DMAC_CTRLA_SRC_WIDTH_BYTE | DMAC_CTRLA_DST_WIDTH_BYTE;
+	case 2:
+		return DMAC_CTRLA_SRC_WIDTH_HALF_WORD | DMAC_CTRLA_DST_WIDTH_HALF_WORD;
+	default:
+		return DMAC_CTRLA_SRC_WIDTH_WORD | DMAC_CTRLA_DST_WIDTH_WORD;
+	}
+}
+
+// Both buffers are filled up front, then the transmit channel goes round
+// them forever, one linked list item each
+void I2SClass::startTx(void) {
+	for (int i = 0; i < 2; i++) {
+		if (txCallback)
+			txCallback(txBuffer[i], I2S_BUFFER_SIZE);
+		else
+			memset(txBuffer[i], 0, I2S_BUFFER_SIZE);
+
+		txDesc[i].saddr = (uint32_t)txBuffer[i];
+		txDesc[i].daddr = (uint32_t)&ssc->SSC_THR;
+		txDesc[i].ctrla = (I2S_BUFFER_SIZE / unit()) | width();
+		txDesc[i].ctrlb = DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM | DMAC_CTRLB_DST_DSCR_FETCH_DISABLE |
+				DMAC_CTRLB_FC_MEM2PER_DMA_FC | DMAC_CTRLB_SRC_INCR_INCREMENTING | DMAC_CTRLB_DST_INCR_FIXED;
+		txDesc[i].dscr = (uint32_t)&txDesc[1 - i];
+	}
+
+	DmacCh_num *tx = &DMAC->DMAC_CH_NUM[I2S_DMAC_TX_CH];
+	tx->DMAC_DADDR = (uint32_t)&ssc->SSC_THR;
+	tx->DMAC_DSCR = (uint32_t)&txDesc[0];
+	tx->DMAC_CTRLB = txDesc[0].ctrlb;
+	tx->DMAC_CFG = DMAC_CFG_DST_PER(I2S_DMAC_TX_PER) | DMAC_CFG_DST_H2SEL_HW |
+			DMAC_CFG_SOD_DISABLE | DMAC_CFG_FIFOCFG_ALAP_CFG;
+
+	dmacAttachInterrupt(I2S_DMAC_TX_CH, I2S_TxHandler);
+	DMAC->DMAC_EBCIER = DMAC_EBCIER_BTC0 << I2S_DMAC_TX_CH;
+	DMAC->DMAC_CHER = DMAC_CHER_ENA0 << I2S_DMAC_TX_CH;
+}
+
+void I2SClass::startRx(void) {
+	for (int i = 0; i < 2; i++) {
+		rxDesc[i].saddr = (uint32_t)&ssc->SSC_RHR;
+		rxDesc[i].daddr = (uint32_t)rxBuffer[i];
+		rxDesc[i].ctrla = (I2S_BUFFER_SIZE / unit()) | width();
+		rxDesc[i].ctrlb = DMAC_CTRLB_SRC_DSCR_FETCH_DISABLE | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM |
+				DMAC_CTRLB_FC_PER2MEM_DMA_FC | DMAC_CTRLB_SRC_INCR_FIXED | DMAC_CTRLB_DST_INCR_INCREMENTING;
+		rxDesc[i].dscr = (uint32_t)&rxDesc[1 - i];
+	}
+
+	DmacCh_num *rx = &DMAC->DMAC_CH_NUM[I2S_DMAC_RX_CH];
+	rx->DMAC_SADDR = (uint32_t)&ssc->SSC_RHR;
+	rx->DMAC_DSCR = (uint32_t)&rxDesc[0];
+	rx->DMAC_CTRLB = rxDesc[0].ctrlb;
+	rx->DMAC_CFG = DMAC_CFG_SRC_PER(I2S_DMAC_RX_PER) | DMAC_CFG_SRC_H2SEL_HW |
+			DMAC_CFG_SOD_DISABLE | DMAC_CFG_FIFOCFG_ASAP_CFG;
+
+	dmacAttachInterrupt(I2S_DMAC_RX_CH, I2S_RxHandler);
+	DMAC->DMAC_EBCIER = DMAC_EBCIER_BTC0 << I2S_DMAC_RX_CH;
+	DMAC->DMAC_CHER = DMAC_CHER_ENA0 << I2S_DMAC_RX_CH;
+	ssc_enable_rx(ssc);
+}
+
+// The channel has moved on to the next buffer already, the one it is not
+// pointing into is the one completed
+void I2SClass::onTxInterrupt(void) {
+	uint32_t addr = DMAC->DMAC_CH_NUM[I2S_DMAC_TX_CH].DMAC_SADDR;
+	uint8_t *done = (addr - (uint32_t)txBuffer[0] < I2S_BUFFER_SIZE) ? txBuffer[1] : txBuffer[0];
+	if (txCallback)
+		txCallback(done, I2S_BUFFER_SIZE);
+}
+
+void I2SClass::onRxInterrupt(void) {
+	uint32_t addr = DMAC->DMAC_CH_NUM[I2S_DMAC_RX_CH].DMAC_DADDR;
+	const uint8_t *done = (addr - (uint32_t)rxBuffer[0] < I2S_BUFFER_SIZE) ? rxBuffer[1] : rxBuffer[0];
+	if (rxCallback)
+		rxCallback(done, I2S_BUFFER_SIZE);
+}
+
+// Data pins are only taken when used, they are analog inputs otherwise
+static void I2S_Init(uint8_t mode) {
+	PIO_Configure(PIOA, PIO_PERIPH_B, PIO_PA14B_TK | PIO_PA15B_TF, PIO_DEFAULT);
+	if (mode & I2S_TX)
+		PIO_Configure(PIOA, PIO_PERIPH_B, PIO_PA16B_TD, PIO_DEFAULT);
+	if (mode & I2S_RX)
+		PIO_Configure(PIOB, PIO_PERIPH_A, PIO_PB18A_RD, PIO_DEFAULT);
+}
+
+I2SClass I2S(SSC, ID_SSC, I2S_Init);
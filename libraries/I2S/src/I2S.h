@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * I2S audio library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _I2S_H_INCLUDED
+#define _I2S_H_INCLUDED
+
+#include <Arduino.h>
+
+// Size in bytes of each of the two buffers per direction. Must hold a
+// whole number of stereo frames.
+#ifndef I2S_BUFFER_SIZE
+#define I2S_BUFFER_SIZE 512
+#endif
+
+#define I2S_TX      (1 << 0)
+#define I2S_RX      (1 << 1)
+#define I2S_DUPLEX  (I2S_TX | I2S_RX)
+
+// Linked list item of the DMA controller
+typedef struct {
+	uint32_t saddr;
+	uint32_t daddr;
+	uint32_t ctrla;
+	uint32_t ctrlb;
+	uint32_t dscr;
+} I2SDmacDescriptor;
+
+// Stereo I2S master on the SSC. The Due drives the bit clock on TK (pin 23)
+// and the word select on TF (pin 24), data goes out on TD (A0) and comes in
+// on RD (A9). The codec needs its own master clock.
+//
+// Samples are moved by the DMA controller between the SSC and two buffers
+// per direction: while one is transferred, the other one is handed to the
+// callback to be filled (transmit) or read (receive). Samples are
+// interleaved left, right; they are int8_t, int16_t or int32_t depending on
+// bitsPerSample, right aligned.
+class I2SClass {
+  public:
+	I2SClass(Ssc *_ssc, uint32_t _id, void(*_initCb)(uint8_t));
+
+	// bitsPerSample is 8 to 32, _mode I2S_TX, I2S_RX or I2S_DUPLEX.
+	// Returns false if the parameters are out of range.
+	bool begin(uint32_t _sampleRate, uint8_t _bitsPerSample, uint8_t _mode = I2S_TX);
+	void end(void);
+
+	// Sample rate really generated, the bit clock is an integer fraction
+	// of the master clock
+	uint32_t sampleRate(void);
+
+	// Called from the interrupt with a buffer to fill, once per buffer.
+	// begin() calls it for both buffers before the transmitter starts.
+	// Without callback silence is sent.
+	void onTransmit(void (*_callback)(void *buf, size_t size));
+	// Called from the interrupt with each buffer received. The data stays
+	// valid until the other buffer has been received.
+	void onReceive(void (*_callback)(const void *buf, size_t size));
+
+	// Called by the DMAC interrupt
+	void onTxInterrupt(void);
+	void onRxInterrupt(void);
+
+  private:
+	void startTx(void);
+	void startRx(void);
+	uint32_t unit(void) { return bits <= 8 ? 1 : (bits <= 16 ? 2 : 4); }
+	uint32_t width(void);
+
+	Ssc *ssc;
+	uint32_t id;
+	void (*initCb)(uint8_t);
+	uint8_t mode;
+	uint8_t bits;
+
+	uint8_t txBuffer[2][I2S_BUFFER_SIZE] __attribute__((aligned(4)));
+	uint8_t rxBuffer[2][I2S_BUFFER_SIZE] __attribute__((aligned(4)));
+	I2SDmacDescriptor txDesc[2];
+	I2SDmacDescriptor rxDesc[2];
+
+	void (*txCallback)(void *, size_t);
+	void (*rxCallback)(const void *, size_t);
+};
+
+extern I2SClass I2S;
+
+#endif
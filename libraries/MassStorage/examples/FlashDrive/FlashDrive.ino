@@ -0,0 +1,30 @@
+// USB flash drive
+//
+// Plug the Native USB port into a computer: the top 64KB of the
+// internal flash show up as a removable drive (format it once).
+// To use an external SPI flash instead, wire its chip select to
+// pin 52 and uncomment the SPIFlashBlockDevice line.
+
+// This example code is in the public domain.
+
+
+#include <SPI.h>
+#include <MassStorage.h>
+#include <InternalFlashBlockDevice.h>
+#include <SPIFlashBlockDevice.h>
+
+InternalFlashBlockDevice flash(64 * 1024);
+//SPIFlashBlockDevice flash(52);
+
+void setup()
+{
+  if (!MassStorage.begin(flash)) {
+    pinMode(LED_BUILTIN, OUTPUT);   // the flash area overlaps the sketch
+    digitalWrite(LED_BUILTIN, HIGH);
+  }
+}
+
+void loop()
+{
+  MassStorage.task();               // serve the host
+}
@@ -0,0 +1,89 @@
+/* Copyright (c) 2015, Arduino LLC
+**
+** Permission to use, copy, modify, and/or distribute this software for
+** any purpose with or without fee is hereby granted, provided that the
+** above copyright notice and this permission notice appear in all copies.
+**
+** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+** WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+** BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+** OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+** WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+** ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+** SOFTWARE.
+*/
+
+#include "InternalFlashBlockDevice.h"
+
+// Lock regions of the SAM3X8E are 16KB (64 pages)
+#define IFLASH1_LOCK_REGION_PAGES 64
+
+// End of the sketch in flash, from the linker script
+extern uint32_t _etext;
+extern uint32_t _srelocate;
+extern uint32_t _erelocate;
+
+InternalFlashBlockDevice::InternalFlashBlockDevice(uint32_t _size)
+{
+	size = min(_size, (uint32_t)IFLASH1_SIZE) & ~(MSC_BLOCK_SIZE - 1);
+	start = IFLASH1_ADDR + IFLASH1_SIZE - size;
+}
+
+bool InternalFlashBlockDevice::begin(void)
+{
+	// Initialized data is stored right after the code
+	uint32_t imageEnd = (uint32_t)&_etext + ((uint32_t)&_erelocate - (uint32_t)&_srelocate);
+	if (size == 0 || start < imageEnd)
+		return false;
+
+	// Programmers may leave the top of the flash locked
+	uint32_t first = (start - IFLASH1_ADDR) / IFLASH1_PAGE_SIZE;
+	for (uint32_t page = first; page < IFLASH1_NB_OF_PAGES; page += IFLASH1_LOCK_REGION_PAGES) {
+		if (efc_perform_command(EFC1, EFC_FCMD_CLB, page) != 0)
+			return false;
+	}
+	return true;
+}
+
+bool InternalFlashBlockDevice::read(uint32_t block, void* data, uint32_t count)
+{
+	if (block + count > blockCount())
+		return false;
+
+	memcpy(data, (const void*)(start + block * MSC_BLOCK_SIZE), count * MSC_BLOCK_SIZE);
+	return true;
+}
+
+bool InternalFlashBlockDevice::write(uint32_t block, const void* data, uint32_t count)
+{
+	if (block + count > blockCount())
+		return false;
+
+	const uint8_t* src = (const uint8_t*)data;
+	uint32_t address = start + block * MSC_BLOCK_SIZE;
+	uint32_t end = address + count * MSC_BLOCK_SIZE;
+	for (; address < end; address += IFLASH1_PAGE_SIZE, src += IFLASH1_PAGE_SIZE) {
+		// Skip pages that do not change, saves an erase cycle
+		if (memcmp((const void*)address, src, IFLASH1_PAGE_SIZE) == 0)
+			continue;
+		if (!writePage(address, src))
+			return false;
+	}
+	return true;
+}
+
+bool InternalFlashBlockDevice::writePage(uint32_t address, const uint8_t* data)
+{
+	// Fill the latch buffer by writing the page in place with 32 bit
+	// accesses, then erase and program it in one command
+	volatile uint32_t* latch = (volatile uint32_t*)address;
+	for (uint32_t i = 0; i < IFLASH1_PAGE_SIZE / 4; i++) {
+		uint32_t word;
+		memcpy(&word, data + i * 4, 4);
+		latch[i] = word;
+	}
+
+	uint32_t page = (address - IFLASH1_ADDR) / IFLASH1_PAGE_SIZE;
+	return efc_perform_command(EFC1, EFC_FCMD_EWP, page) == 0;
+}
@@ -0,0 +1,44 @@
+/*
+  Copyright (c) 2015, Arduino LLC
+
+  Permission to use, copy, modify, and/or distribute this software for
+  any purpose with or without fee is hereby granted, provided that the
+  above copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+  WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+  BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+  OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+  WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+  ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+  SOFTWARE.
+ */
+
+#ifndef InternalFlashBlockDevice_h
+#define InternalFlashBlockDevice_h
+
+#include <Arduino.h>
+#include "MSCBlockDevice.h"
+
+// Block device on the top of the second flash bank (EFC1). Reads are plain
+// memory copies, writes erase and program 256 byte pages through the
+// IAP routine in ROM. begin() fails if the area overlaps the sketch.
+class InternalFlashBlockDevice : public MSCBlockDevice
+{
+public:
+  InternalFlashBlockDevice(uint32_t size = 64 * 1024);
+
+  bool begin(void);
+  uint32_t blockCount(void) { return size / MSC_BLOCK_SIZE; }
+  bool read(uint32_t block, void* data, uint32_t count);
+  bool write(uint32_t block, const void* data, uint32_t count);
+
+private:
+  bool writePage(uint32_t address, const uint8_t* data);
+
+  uint32_t start;
+  uint32_t size;
+};
+
+#endif // InternalFlashBlockDevice_h
@@ -0,0 +1,42 @@
+/*
+  Copyright (c) 2015, Arduino LLC
+
+  Permission to use, copy, modify, and/or distribute this software for
+  any purpose with or without fee is hereby granted, provided that the
+  above copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+  WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+  BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+  OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+  WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+  ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+  SOFTWARE.
+ */
+
+#ifndef MSCBlockDevice_h
+#define MSCBlockDevice_h
+
+#include <stdint.h>
+
+// All block devices are addressed in 512 byte blocks
+#define MSC_BLOCK_SIZE 512
+
+// Storage behind the mass storage module. read() and write() are always
+// called with as many consecutive blocks as possible so that backends
+// can use multi-sector commands.
+class MSCBlockDevice
+{
+public:
+  virtual bool begin(void) = 0;
+  virtual uint32_t blockCount(void) = 0;
+  virtual bool read(uint32_t block, void* data, uint32_t count) = 0;
+  virtual bool write(uint32_t block, const void* data, uint32_t count) = 0;
+
+  // Commit writes the backend holds back (erase block caches)
+  virtual bool sync(void) { return true; }
+  virtual bool isWritable(void) { return true; }
+};
+
+#endif // MSCBlockDevice_h
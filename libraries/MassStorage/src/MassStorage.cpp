@@ -0,0 +1,432 @@
+/* Copyright (c) 2015, Arduino LLC
+**
+** Permission to use, copy, modify, and/or distribute this software for
+** any purpose with or without fee is hereby granted, provided that the
+** above copyright notice and this permission notice appear in all copies.
+**
+** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+** WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+** BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+** OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+** WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+** ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+** SOFTWARE.
+*/
+
+#include "MassStorage.h"
+
+#if defined(USBCON)
+
+// Single banked OUT endpoint so that CDC, mass storage and HID all fit
+// in DPRAM; the IN endpoint keeps two banks for read throughput
+#define EP_TYPE_BULK_OUT_MSC	(UOTGHS_DEVEPTCFG_EPSIZE_512_BYTE | \
+								UOTGHS_DEVEPTCFG_EPTYPE_BLK |       \
+								UOTGHS_DEVEPTCFG_EPBK_1_BANK |      \
+								UOTGHS_DEVEPTCFG_NBTRANS_1_TRANS |  \
+								UOTGHS_DEVEPTCFG_ALLOC)
+
+#define MSC_ENDPOINT_OUT		(pluggedEndpoint)
+#define MSC_ENDPOINT_IN			(pluggedEndpoint+1)
+
+#define MSC_CBW_DIRECTION_IN	0x80
+
+// Idle time after which blocks held back by the backend are committed
+#define MSC_SYNC_DELAY			500
+
+static const uint8_t inquiryData[36] = {
+	0x00,	// Direct access block device
+	0x80,	// Removable
+	0x04,	// SPC-2
+	0x02,	// Response data format
+	31,		// Additional length
+	0x00, 0x00, 0x00,
+	'A', 'r', 'd', 'u', 'i', 'n', 'o', ' ',
+	'D', 'u', 'e', ' ', 'S', 't', 'o', 'r', 'a', 'g', 'e', ' ', ' ', ' ', ' ', ' ',
+	'1', '.', '0', ' '
+};
+
+static inline uint32_t readBE32(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void writeBE32(uint8_t* p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+MassStorage_ MassStorage;
+
+MassStorage_::MassStorage_(void) : PluggableUSBModule(2, 1, epType),
+                                   device(NULL), blocks(0), residue(0),
+                                   senseKey(SCSI_SENSE_NONE), senseCode(0),
+                                   bufferBlock(0), bufferCount(0),
+                                   pendingSync(false), lastWrite(0), resetRequest(false)
+{
+	epType[0] = EP_TYPE_BULK_OUT_MSC;
+	epType[1] = EP_TYPE_BULK_IN;
+	PluggableUSB().plug(this);
+}
+
+int MassStorage_::getInterface(uint8_t* interfaceCount)
+{
+	*interfaceCount += 1; // uses 1
+	const uint16_t packetSize = USBD_IsHighSpeed() ? 512 : 64;
+	MSCDescriptor mscInterface = {
+		D_INTERFACE(pluggedInterface, 2, USB_DEVICE_CLASS_STORAGE, MSC_SUBCLASS_SCSI, MSC_PROTOCOL_BULK_ONLY),
+		D_ENDPOINT(USB_ENDPOINT_IN(MSC_ENDPOINT_IN), USB_ENDPOINT_TYPE_BULK, packetSize, 0),
+		D_ENDPOINT(USB_ENDPOINT_OUT(MSC_ENDPOINT_OUT), USB_ENDPOINT_TYPE_BULK, packetSize, 0)
+	};
+	return USBD_SendControl(0, &mscInterface, sizeof(mscInterface));
+}
+
+int MassStorage_::getDescriptor(USBSetup& setup __attribute__((unused)))
+{
+	return 0;
+}
+
+uint8_t MassStorage_::getShortName(char *name)
+{
+	name[0] = 'M';
+	name[1] = 'S';
+	name[2] = 'C';
+	return 3;
+}
+
+bool MassStorage_::setup(USBSetup& setup)
+{
+	if (pluggedInterface != setup.wIndex) {
+		return false;
+	}
+
+	uint8_t request = setup.bRequest;
+	uint8_t requestType = setup.bmRequestType;
+
+	if (requestType == REQUEST_DEVICETOHOST_CLASS_INTERFACE)
+	{
+		if (request == MSC_REQUEST_GET_MAX_LUN) {
+			uint8_t maxLun = 0;
+			USBD_SendControl(0, &maxLun, 1);
+			return true;
+		}
+	}
+
+	if (requestType == REQUEST_HOSTTODEVICE_CLASS_INTERFACE)
+	{
+		if (request == MSC_REQUEST_RESET) {
+			// Abort the command in progress, task() waits for a new CBW
+			resetRequest = true;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool MassStorage_::begin(MSCBlockDevice& _device)
+{
+	if (!_device.begin())
+		return false;
+
+	blocks = _device.blockCount();
+	bufferCount = 0;
+	pendingSync = false;
+	device = &_device;
+
+	// Tell the host the medium changed
+	setSense(SCSI_SENSE_UNIT_ATTENTION, SCSI_ASC_MEDIUM_CHANGED);
+	return true;
+}
+
+void MassStorage_::end(void)
+{
+	if (device && pendingSync)
+		device->sync();
+	pendingSync = false;
+	device = NULL;
+	bufferCount = 0;
+}
+
+bool MassStorage_::connected(void)
+{
+	return USBDevice.configured() && !resetRequest;
+}
+
+void MassStorage_::task(void)
+{
+	if (!USBDevice.configured())
+		return;
+	resetRequest = false;
+
+	if (pendingSync && millis() - lastWrite > MSC_SYNC_DELAY) {
+		device->sync();
+		pendingSync = false;
+	}
+
+	if (!USBD_Available(MSC_ENDPOINT_OUT))
+		return;
+
+	uint32_t len = USBD_Recv(MSC_ENDPOINT_OUT, &cbw, sizeof(cbw));
+	if (len != sizeof(cbw) || cbw.signature != MSC_CBW_SIGNATURE) {
+		// Not a command, drop the rest of the packet
+		uint8_t discard[64];
+		while (USBD_Available(MSC_ENDPOINT_OUT))
+			USBD_Recv(MSC_ENDPOINT_OUT, discard, sizeof(discard));
+		return;
+	}
+
+	residue = cbw.dataLength;
+	command();
+}
+
+void MassStorage_::command(void)
+{
+	const uint8_t* cb = cbw.cb;
+
+	// Commands that work without a medium
+	switch (cb[0])
+	{
+	case SCSI_INQUIRY:
+		sendData(inquiryData, min((uint32_t)cb[4], sizeof(inquiryData)));
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+
+	case SCSI_REQUEST_SENSE:
+	{
+		uint8_t sense[18] = { 0x70, 0, senseKey, 0, 0, 0, 0, 10, 0, 0, 0, 0, senseCode, 0, 0, 0, 0, 0 };
+		sendData(sense, min((uint32_t)cb[4], sizeof(sense)));
+		setSense(SCSI_SENSE_NONE, 0);
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+	}
+
+	case SCSI_PREVENT_ALLOW_REMOVAL:
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+	}
+
+	if (!device) {
+		setSense(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+		sendStatus(MSC_CSW_STATUS_FAILED);
+		return;
+	}
+
+	switch (cb[0])
+	{
+	case SCSI_TEST_UNIT_READY:
+		// A medium change is reported until the host fetched the sense
+		if (senseKey == SCSI_SENSE_UNIT_ATTENTION) {
+			sendStatus(MSC_CSW_STATUS_FAILED);
+			return;
+		}
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+
+	case SCSI_READ_CAPACITY_10:
+	{
+		uint8_t capacity[8];
+		writeBE32(capacity, blocks - 1);
+		writeBE32(capacity + 4, MSC_BLOCK_SIZE);
+		sendData(capacity, sizeof(capacity));
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+	}
+
+	case SCSI_READ_FORMAT_CAPACITIES:
+	{
+		uint8_t capacities[12] = { 0, 0, 0, 8 };
+		writeBE32(capacities + 4, blocks);
+		writeBE32(capacities + 8, MSC_BLOCK_SIZE);
+		capacities[8] = 0x02; // Formatted media
+		sendData(capacities, sizeof(capacities));
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+	}
+
+	case SCSI_MODE_SENSE_6:
+	{
+		uint8_t mode[4] = { 3, 0, (uint8_t)(device->isWritable() ? 0x00 : 0x80), 0 };
+		sendData(mode, min((uint32_t)cb[4], sizeof(mode)));
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+	}
+
+	case SCSI_MODE_SENSE_10:
+	{
+		uint8_t mode[8] = { 0, 6, 0, (uint8_t)(device->isWritable() ? 0x00 : 0x80), 0, 0, 0, 0 };
+		sendData(mode, min((uint32_t)((cb[7] << 8) | cb[8]), sizeof(mode)));
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+	}
+
+	case SCSI_START_STOP_UNIT:
+		// Eject: commit everything, the medium is gone until begin()
+		if ((cb[4] & 0x03) == 0x02)
+			end();
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+
+	case SCSI_SYNCHRONIZE_CACHE_10:
+		pendingSync = false;
+		sendStatus(device->sync() ? MSC_CSW_STATUS_PASSED : MSC_CSW_STATUS_FAILED);
+		return;
+
+	case SCSI_VERIFY_10:
+		sendStatus(MSC_CSW_STATUS_PASSED);
+		return;
+
+	case SCSI_READ_10:
+	{
+		uint32_t block = readBE32(cb + 2);
+		uint32_t count = (cb[7] << 8) | cb[8];
+		if (checkRange(block, count))
+			readBlocks(block, count);
+		return;
+	}
+
+	case SCSI_WRITE_10:
+	{
+		uint32_t block = readBE32(cb + 2);
+		uint32_t count = (cb[7] << 8) | cb[8];
+		if (!device->isWritable()) {
+			setSense(SCSI_SENSE_DATA_PROTECT, SCSI_ASC_WRITE_PROTECTED);
+			sendStatus(MSC_CSW_STATUS_FAILED);
+			return;
+		}
+		if (checkRange(block, count))
+			writeBlocks(block, count);
+		return;
+	}
+	}
+
+	setSense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_COMMAND);
+	sendStatus(MSC_CSW_STATUS_FAILED);
+}
+
+bool MassStorage_::checkRange(uint32_t block, uint32_t count)
+{
+	if (block >= blocks || count > blocks - block || count * MSC_BLOCK_SIZE > cbw.dataLength) {
+		setSense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_LBA_OUT_OF_RANGE);
+		sendStatus(MSC_CSW_STATUS_FAILED);
+		return false;
+	}
+	return true;
+}
+
+void MassStorage_::readBlocks(uint32_t block, uint32_t count)
+{
+	while (count) {
+		if (block < bufferBlock || block >= bufferBlock + bufferCount) {
+			// Fill the whole buffer, following reads are likely sequential
+			uint32_t n = min((uint32_t)MSC_BUFFER_BLOCKS, blocks - block);
+			if (!device->read(block, buffer, n)) {
+				bufferCount = 0;
+				setSense(SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_UNRECOVERED_READ);
+				sendStatus(MSC_CSW_STATUS_FAILED);
+				return;
+			}
+			bufferBlock = block;
+			bufferCount = n;
+		}
+
+		uint32_t offset = block - bufferBlock;
+		uint32_t n = min(count, bufferCount - offset);
+		if (!sendData(buffer + offset * MSC_BLOCK_SIZE, n * MSC_BLOCK_SIZE))
+			return;
+		block += n;
+		count -= n;
+	}
+	sendStatus(MSC_CSW_STATUS_PASSED);
+}
+
+void MassStorage_::writeBlocks(uint32_t block, uint32_t count)
+{
+	// The buffer is reused for the incoming data
+	bufferCount = 0;
+
+	while (count) {
+		uint32_t n = min(count, (uint32_t)MSC_BUFFER_BLOCKS);
+		if (!recvData(buffer, n * MSC_BLOCK_SIZE))
+			return;
+		if (!device->write(block, buffer, n)) {
+			setSense(SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_WRITE_FAULT);
+			sendStatus(MSC_CSW_STATUS_FAILED);
+			return;
+		}
+		block += n;
+		count -= n;
+	}
+
+	pendingSync = true;
+	lastWrite = millis();
+	sendStatus(MSC_CSW_STATUS_PASSED);
+}
+
+//	Data-In phase, clipped to what the host asked for
+bool MassStorage_::sendData(const void* data, uint32_t len)
+{
+	len = min(len, residue);
+	if (!len)
+		return true;
+	if (!connected() || USBD_Send(MSC_ENDPOINT_IN, data, len) != len)
+		return false;
+	residue -= len;
+	return true;
+}
+
+//	Data-Out phase, blocks until len bytes arrived
+bool MassStorage_::recvData(void* data, uint32_t len)
+{
+	uint8_t* dst = (uint8_t*)data;
+	len = min(len, residue);
+	while (len) {
+		if (!connected())
+			return false;
+		if (!USBD_Available(MSC_ENDPOINT_OUT))
+			continue;
+		uint32_t n = USBD_Recv(MSC_ENDPOINT_OUT, dst, len);
+		if (n == (uint32_t)-1)
+			return false;
+		dst += n;
+		len -= n;
+		residue -= n;
+	}
+	return true;
+}
+
+void MassStorage_::sendStatus(uint8_t status)
+{
+	// The endpoints can not be halted, so a data phase the command did
+	// not use up is padded (Data-In) or drained (Data-Out) instead.
+	// dCSWDataResidue still tells the host how much was real.
+	uint32_t unused = residue;
+	if (unused) {
+		uint8_t pad[64];
+		if (cbw.flags & MSC_CBW_DIRECTION_IN) {
+			memset(pad, 0, sizeof(pad));
+			while (residue)
+				if (!sendData(pad, min(residue, sizeof(pad))))
+					return;
+		} else {
+			while (residue)
+				if (!recvData(pad, min(residue, sizeof(pad))))
+					return;
+		}
+	}
+
+	MSCCommandStatusWrapper csw = { MSC_CSW_SIGNATURE, cbw.tag, unused, status };
+	if (connected())
+		USBD_Send(MSC_ENDPOINT_IN, &csw, sizeof(csw));
+}
+
+void MassStorage_::setSense(uint8_t key, uint8_t asc)
+{
+	senseKey = key;
+	senseCode = asc;
+}
+
+#endif /* if defined(USBCON) */
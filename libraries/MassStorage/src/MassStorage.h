@@ -0,0 +1,160 @@
+/*
+  Copyright (c) 2015, Arduino LLC
+
+  Permission to use, copy, modify, and/or distribute this software for
+  any purpose with or without fee is hereby granted, provided that the
+  above copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+  WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+  BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+  OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+  WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+  ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+  SOFTWARE.
+ */
+
+#ifndef MassStorage_h
+#define MassStorage_h
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "USB/PluggableUSB.h"
+#include "MSCBlockDevice.h"
+
+#if defined(USBCON)
+
+#define _USING_MASS_STORAGE
+
+// Blocks moved per device access. Reads fill the whole buffer, so small
+// sequential host reads are served from memory (read-ahead).
+#ifndef MSC_BUFFER_BLOCKS
+#define MSC_BUFFER_BLOCKS 8
+#endif
+
+// Mass Storage Bulk-Only Transport 'Driver'
+// -----------------------------------------
+#define MSC_SUBCLASS_SCSI              0x06
+#define MSC_PROTOCOL_BULK_ONLY         0x50
+
+#define MSC_REQUEST_RESET              0xFF
+#define MSC_REQUEST_GET_MAX_LUN        0xFE
+
+#define MSC_CBW_SIGNATURE              0x43425355
+#define MSC_CSW_SIGNATURE              0x53425355
+
+#define MSC_CSW_STATUS_PASSED          0x00
+#define MSC_CSW_STATUS_FAILED          0x01
+#define MSC_CSW_STATUS_PHASE_ERROR     0x02
+
+// SCSI commands
+#define SCSI_TEST_UNIT_READY           0x00
+#define SCSI_REQUEST_SENSE             0x03
+#define SCSI_INQUIRY                   0x12
+#define SCSI_MODE_SENSE_6              0x1A
+#define SCSI_START_STOP_UNIT           0x1B
+#define SCSI_PREVENT_ALLOW_REMOVAL     0x1E
+#define SCSI_READ_FORMAT_CAPACITIES    0x23
+#define SCSI_READ_CAPACITY_10          0x25
+#define SCSI_READ_10                   0x28
+#define SCSI_WRITE_10                  0x2A
+#define SCSI_VERIFY_10                 0x2F
+#define SCSI_SYNCHRONIZE_CACHE_10      0x35
+#define SCSI_MODE_SENSE_10             0x5A
+
+// Sense keys and additional sense codes
+#define SCSI_SENSE_NONE                0x00
+#define SCSI_SENSE_NOT_READY           0x02
+#define SCSI_SENSE_MEDIUM_ERROR        0x03
+#define SCSI_SENSE_ILLEGAL_REQUEST     0x05
+#define SCSI_SENSE_UNIT_ATTENTION      0x06
+#define SCSI_SENSE_DATA_PROTECT        0x07
+
+#define SCSI_ASC_INVALID_COMMAND       0x20
+#define SCSI_ASC_LBA_OUT_OF_RANGE      0x21
+#define SCSI_ASC_WRITE_PROTECTED       0x27
+#define SCSI_ASC_MEDIUM_CHANGED        0x28
+#define SCSI_ASC_MEDIUM_NOT_PRESENT    0x3A
+#define SCSI_ASC_WRITE_FAULT           0x03
+#define SCSI_ASC_UNRECOVERED_READ      0x11
+
+typedef struct
+{
+  uint32_t signature;
+  uint32_t tag;
+  uint32_t dataLength;
+  uint8_t  flags;
+  uint8_t  lun;
+  uint8_t  cbLength;
+  uint8_t  cb[16];
+} __attribute__((packed)) MSCCommandBlockWrapper;
+
+typedef struct
+{
+  uint32_t signature;
+  uint32_t tag;
+  uint32_t dataResidue;
+  uint8_t  status;
+} __attribute__((packed)) MSCCommandStatusWrapper;
+
+class MassStorage_ : public PluggableUSBModule
+{
+public:
+  MassStorage_(void);
+
+  // Expose device to the host. The medium is reported as not present
+  // until begin() succeeded; end() ejects it again.
+  bool begin(MSCBlockDevice& device);
+  void end(void);
+
+  // Bulk-Only Transport is driven from here, call it from loop()
+  void task(void);
+
+protected:
+  // Implementation of the PluggableUSBModule
+  int getInterface(uint8_t* interfaceCount);
+  int getDescriptor(USBSetup& setup);
+  bool setup(USBSetup& setup);
+  uint8_t getShortName(char* name);
+
+private:
+  void command(void);
+  void readBlocks(uint32_t block, uint32_t count);
+  void writeBlocks(uint32_t block, uint32_t count);
+
+  bool sendData(const void* data, uint32_t len);
+  bool recvData(void* data, uint32_t len);
+  void sendStatus(uint8_t status);
+  void setSense(uint8_t key, uint8_t asc);
+  bool checkRange(uint32_t block, uint32_t count);
+  bool connected(void);
+
+  uint32_t epType[2];
+
+  MSCBlockDevice* device;
+  uint32_t blocks;
+
+  MSCCommandBlockWrapper cbw;
+  uint32_t residue;
+
+  uint8_t senseKey;
+  uint8_t senseCode;
+
+  // Read-ahead / multi-sector buffer
+  uint8_t buffer[MSC_BUFFER_BLOCKS * MSC_BLOCK_SIZE] __attribute__((aligned(4)));
+  uint32_t bufferBlock;
+  uint32_t bufferCount;
+
+  // Backend holds unsynced writes
+  bool pendingSync;
+  uint32_t lastWrite;
+
+  volatile bool resetRequest;
+};
+
+extern MassStorage_ MassStorage;
+
+#endif // USBCON
+
+#endif // MassStorage_h
@@ -0,0 +1,176 @@
+/* Copyright (c) 2015, Arduino LLC
+**
+** Permission to use, copy, modify, and/or distribute this software for
+** any purpose with or without fee is hereby granted, provided that the
+** above copyright notice and this permission notice appear in all copies.
+**
+** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+** WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+** BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+** OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+** WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+** ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+** SOFTWARE.
+*/
+
+#include "SPIFlashBlockDevice.h"
+
+#define SPIFLASH_WRITE_ENABLE     0x06
+#define SPIFLASH_READ_STATUS      0x05
+#define SPIFLASH_PAGE_PROGRAM     0x02
+#define SPIFLASH_FAST_READ        0x0B
+#define SPIFLASH_SECTOR_ERASE     0x20
+#define SPIFLASH_JEDEC_ID         0x9F
+#define SPIFLASH_RELEASE_POWER    0xAB
+
+#define SPIFLASH_STATUS_BUSY      0x01
+
+#define SPIFLASH_NO_SECTOR        0xFFFFFFFF
+
+SPIFlashBlockDevice::SPIFlashBlockDevice(uint8_t csPin, uint32_t clock, SPIClass& _spi) :
+	spi(_spi), settings(clock, MSBFIRST, SPI_MODE0), pin(csPin), capacity(0),
+	cacheSector(SPIFLASH_NO_SECTOR), cacheDirty(false)
+{
+	// Empty
+}
+
+bool SPIFlashBlockDevice::begin(void)
+{
+	spi.begin(pin);
+
+	// Wake the chip up in case it was left in deep power down
+	command(SPIFLASH_RELEASE_POWER);
+	delayMicroseconds(50);
+
+	// Manufacturer, memory type, capacity as a power of two
+	spi.beginTransaction(pin, settings);
+	spi.transfer(pin, SPIFLASH_JEDEC_ID, SPI_CONTINUE);
+	spi.transfer(pin, 0, SPI_CONTINUE);
+	spi.transfer(pin, 0, SPI_CONTINUE);
+	uint8_t size = spi.transfer(pin, 0, SPI_LAST);
+	spi.endTransaction();
+
+	if (size < 16 || size > 24) // 64KB up to 16MB, 3 byte addressing only
+		return false;
+
+	capacity = 1UL << size;
+	cacheSector = SPIFLASH_NO_SECTOR;
+	cacheDirty = false;
+	return true;
+}
+
+bool SPIFlashBlockDevice::read(uint32_t block, void* data, uint32_t count)
+{
+	if (block + count > blockCount())
+		return false;
+
+	uint32_t addr = block * MSC_BLOCK_SIZE;
+	uint32_t len = count * MSC_BLOCK_SIZE;
+
+	// Reads must see what is still held back in the cache
+	if (cacheDirty && cacheSector * SPIFLASH_SECTOR_SIZE < addr + len &&
+			addr < (cacheSector + 1) * SPIFLASH_SECTOR_SIZE) {
+		if (!sync())
+			return false;
+	}
+
+	// All blocks in one command
+	readData(addr, data, len);
+	return true;
+}
+
+bool SPIFlashBlockDevice::write(uint32_t block, const void* data, uint32_t count)
+{
+	if (block + count > blockCount())
+		return false;
+
+	const uint8_t* src = (const uint8_t*)data;
+	uint32_t addr = block * MSC_BLOCK_SIZE;
+	for (uint32_t i = 0; i < count; i++, addr += MSC_BLOCK_SIZE, src += MSC_BLOCK_SIZE) {
+		uint32_t sector = addr / SPIFLASH_SECTOR_SIZE;
+		if (sector != cacheSector) {
+			if (!sync())
+				return false;
+			readData(sector * SPIFLASH_SECTOR_SIZE, cache, SPIFLASH_SECTOR_SIZE);
+			cacheSector = sector;
+		}
+		memcpy(cache + (addr % SPIFLASH_SECTOR_SIZE), src, MSC_BLOCK_SIZE);
+		cacheDirty = true;
+	}
+	return true;
+}
+
+bool SPIFlashBlockDevice::sync(void)
+{
+	if (!cacheDirty)
+		return true;
+
+	uint32_t addr = cacheSector * SPIFLASH_SECTOR_SIZE;
+
+	writeEnable();
+	command(SPIFLASH_SECTOR_ERASE, SPI_CONTINUE);
+	address(addr, SPI_LAST);
+	spi.endTransaction();
+	waitReady();
+
+	for (uint32_t offset = 0; offset < SPIFLASH_SECTOR_SIZE; offset += SPIFLASH_PAGE_SIZE) {
+		// Erased pages stay as they are
+		const uint8_t* src = cache + offset;
+		uint32_t i = 0;
+		while (i < SPIFLASH_PAGE_SIZE && src[i] == 0xFF)
+			i++;
+		if (i == SPIFLASH_PAGE_SIZE)
+			continue;
+
+		writeEnable();
+		command(SPIFLASH_PAGE_PROGRAM, SPI_CONTINUE);
+		address(addr + offset);
+		spi.write(pin, src, SPIFLASH_PAGE_SIZE, SPI_LAST);
+		spi.endTransaction();
+		waitReady();
+	}
+
+	cacheDirty = false;
+	return true;
+}
+
+// Starts a transaction that the caller ends unless mode is SPI_LAST
+uint8_t SPIFlashBlockDevice::command(uint8_t cmd, SPITransferMode mode)
+{
+	spi.beginTransaction(pin, settings);
+	uint8_t r = spi.transfer(pin, cmd, mode);
+	if (mode == SPI_LAST)
+		spi.endTransaction();
+	return r;
+}
+
+void SPIFlashBlockDevice::address(uint32_t addr, SPITransferMode mode)
+{
+	spi.transfer(pin, (uint8_t)(addr >> 16), SPI_CONTINUE);
+	spi.transfer(pin, (uint8_t)(addr >> 8), SPI_CONTINUE);
+	spi.transfer(pin, (uint8_t)addr, mode);
+}
+
+void SPIFlashBlockDevice::waitReady(void)
+{
+	command(SPIFLASH_READ_STATUS, SPI_CONTINUE);
+	while (spi.transfer(pin, 0, SPI_CONTINUE) & SPIFLASH_STATUS_BUSY)
+		;
+	spi.transfer(pin, 0, SPI_LAST);
+	spi.endTransaction();
+}
+
+void SPIFlashBlockDevice::writeEnable(void)
+{
+	command(SPIFLASH_WRITE_ENABLE);
+}
+
+void SPIFlashBlockDevice::readData(uint32_t addr, void* data, uint32_t len)
+{
+	command(SPIFLASH_FAST_READ, SPI_CONTINUE);
+	address(addr);
+	spi.transfer(pin, 0, SPI_CONTINUE); // dummy cycle
+	spi.read(pin, data, len, 0xFF, SPI_LAST);
+	spi.endTransaction();
+}
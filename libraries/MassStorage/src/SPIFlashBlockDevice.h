@@ -0,0 +1,62 @@
+/*
+  Copyright (c) 2015, Arduino LLC
+
+  Permission to use, copy, modify, and/or distribute this software for
+  any purpose with or without fee is hereby granted, provided that the
+  above copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+  WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+  BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+  OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+  WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+  ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+  SOFTWARE.
+ */
+
+#ifndef SPIFlashBlockDevice_h
+#define SPIFlashBlockDevice_h
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "MSCBlockDevice.h"
+
+#define SPIFLASH_SECTOR_SIZE  4096
+#define SPIFLASH_PAGE_SIZE    256
+
+// Block device on a JEDEC compatible serial NOR flash (W25Qxx, AT25SF,
+// MX25L...). The capacity is taken from the JEDEC ID. Writes are collected
+// in a one sector (4KB) cache so that consecutive blocks cost one erase;
+// the sector is committed when another one is written or on sync().
+//
+// csPin must be one of the SPI chip select pins (4, 10, 52).
+class SPIFlashBlockDevice : public MSCBlockDevice
+{
+public:
+  SPIFlashBlockDevice(uint8_t csPin, uint32_t clock = 28000000, SPIClass& spi = SPI);
+
+  bool begin(void);
+  uint32_t blockCount(void) { return capacity / MSC_BLOCK_SIZE; }
+  bool read(uint32_t block, void* data, uint32_t count);
+  bool write(uint32_t block, const void* data, uint32_t count);
+  bool sync(void);
+
+private:
+  uint8_t command(uint8_t cmd, SPITransferMode mode = SPI_LAST);
+  void address(uint32_t addr, SPITransferMode mode = SPI_CONTINUE);
+  void waitReady(void);
+  void writeEnable(void);
+  void readData(uint32_t addr, void* data, uint32_t len);
+
+  SPIClass& spi;
+  SPISettings settings;
+  uint8_t pin;
+  uint32_t capacity;
+
+  uint8_t cache[SPIFLASH_SECTOR_SIZE];
+  uint32_t cacheSector;
+  bool cacheDirty;
+};
+
+#endif // SPIFlashBlockDevice_h
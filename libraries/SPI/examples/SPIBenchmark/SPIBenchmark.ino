@@ -0,0 +1,208 @@
+/*
+  SPI Benchmark
+
+  Measures the SPI library: single byte, 16 bit, buffered (polled and DMA)
+  and asynchronous transfers, for several clock speeds and buffer sizes.
+  For every test the serial monitor shows
+
+  * bytes/s   - payload moved per second
+  * cycles    - CPU cycles per call, counted by the DWT cycle counter
+  * CPU       - share of the time the CPU was kept busy by the transfer.
+                Synchronous transfers wait for the bus, that is always
+                100%. For asynchronous ones it is the time not left to
+                the sketch while the DMA controller runs.
+
+  Nothing needs to be connected. Connect MOSI to MISO (ICSP pins 4 and 1)
+  to check the received data as well.
+
+  Without a board, extras/host in the library builds SPI.cpp on the PC
+  against a simulated SPI controller and DMA controller and checks the
+  data and the path (polled, DMA, 9 to 16 bit frames) of every transfer:
+  run 'make check' there.
+
+  This example code is in the public domain.
+*/
+
+#include <SPI.h>
+
+// Chip select, any of the SPI chip select pins (4, 10, 52)
+const int csPin = 10;
+
+// DWT cycle counter, not covered by the CMSIS headers of this core
+#define DWT_CTRL    (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT  (*(volatile uint32_t *)0xE0001004)
+#define DWT_CTRL_CYCCNTENA  (1UL << 0)
+
+const uint32_t clocks[] = { 1000000, 4000000, 10500000, 21000000, 42000000 };
+const size_t sizes[] = { 16, 32, 64, 512, 4096 };
+
+uint8_t txBuf[4096];
+uint8_t rxBuf[4096];
+
+// Cycles of 1000 rounds of the idle loop in asyncTest()
+uint32_t idleLoopCycles;
+volatile bool asyncDone;
+// Milliseconds left until the SysTick ends the calibration loop
+volatile uint32_t calibrateTicks;
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial)
+    ;
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+
+  for (size_t i = 0; i < sizeof(txBuf); i++)
+    txBuf[i] = i * 7 + 1;
+
+  SPI.begin(csPin);
+  calibrateIdleLoop();
+
+  for (size_t c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++) {
+    SPISettings settings(clocks[c], MSBFIRST, SPI_MODE0);
+    Serial.print("SPI clock ");
+    Serial.print(clocks[c]);
+    Serial.println(" Hz");
+
+    byteTest(settings);
+    word16Test(settings, "transfer16");
+    // One native 16 bit frame per call instead of two bytes
+    word16Test(SPISettings(clocks[c], MSBFIRST, SPI_MODE0, 16), "transfer16 (16 bit frames)");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+      bufferTest(settings, sizes[s]);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+      asyncTest(settings, sizes[s]);
+    Serial.println();
+  }
+}
+
+void loop() {
+}
+
+void report(const char *name, size_t size, uint32_t calls, uint32_t bytes, uint32_t cycles, uint32_t busyCycles, bool checked) {
+  Serial.print("  ");
+  Serial.print(name);
+  if (size) {
+    Serial.print(' ');
+    Serial.print(size);
+  }
+  Serial.print(": ");
+  Serial.print((uint32_t)((uint64_t)bytes * F_CPU / cycles));
+  Serial.print(" bytes/s, ");
+  Serial.print(cycles / calls);
+  Serial.print(" cycles/call, CPU ");
+  Serial.print((uint32_t)((uint64_t)busyCycles * 100 / cycles));
+  Serial.print('%');
+  if (checked)
+    Serial.print(", loopback ok");
+  Serial.println();
+}
+
+void byteTest(SPISettings settings) {
+  const uint32_t calls = 1000;
+  bool ok = true;
+
+  SPI.beginTransaction(csPin, settings);
+  uint32_t start = DWT_CYCCNT;
+  for (uint32_t i = 0; i < calls; i++) {
+    if (SPI.transfer(csPin, (uint8_t)i, SPI_CONTINUE) != (uint8_t)i)
+      ok = false;
+  }
+  uint32_t cycles = DWT_CYCCNT - start;
+  SPI.transfer(csPin, 0, SPI_LAST);
+  SPI.endTransaction();
+
+  report("transfer", 0, calls, calls, cycles, cycles, ok);
+}
+
+void word16Test(SPISettings settings, const char *name) {
+  const uint32_t calls = 1000;
+  bool ok = true;
+
+  SPI.beginTransaction(csPin, settings);
+  uint32_t start = DWT_CYCCNT;
+  for (uint32_t i = 0; i < calls; i++) {
+    if (SPI.transfer16(csPin, (uint16_t)(i * 257), SPI_CONTINUE) != (uint16_t)(i * 257))
+      ok = false;
+  }
+  uint32_t cycles = DWT_CYCCNT - start;
+  SPI.transfer(csPin, 0, SPI_LAST);
+  SPI.endTransaction();
+
+  report(name, 0, calls, calls * 2, cycles, cycles, ok);
+}
+
+// Buffers longer than SPI_DMA_THRESHOLD go through the DMA controller
+void bufferTest(SPISettings settings, size_t size) {
+  const uint32_t calls = 20;
+  bool ok = true;
+
+  SPI.beginTransaction(csPin, settings);
+  uint32_t cycles = 0;
+  for (uint32_t i = 0; i < calls; i++) {
+    memcpy(rxBuf, txBuf, size);
+    uint32_t start = DWT_CYCCNT;
+    SPI.transfer(csPin, rxBuf, size);
+    cycles += DWT_CYCCNT - start;
+    if (memcmp(rxBuf, txBuf, size) != 0)
+      ok = false;
+  }
+  SPI.endTransaction();
+
+  report(size > SPI_DMA_THRESHOLD ? "buffer (DMA)" : "buffer", size, calls, calls * size, cycles, cycles, ok);
+}
+
+void asyncDoneCallback() {
+  asyncDone = true;
+}
+
+// The sketch counts idle loops while the transfer runs, the cycles they
+// account for were free for other work
+void asyncTest(SPISettings settings, size_t size) {
+  const uint32_t calls = 20;
+  uint32_t cycles = 0;
+  uint32_t idle = 0;
+  bool ok = true;
+
+  for (uint32_t i = 0; i < calls; i++) {
+    memset(rxBuf, 0, size);
+    asyncDone = false;
+    uint32_t start = DWT_CYCCNT;
+    if (!SPI.transferAsync(csPin, settings, txBuf, rxBuf, size, asyncDoneCallback)) {
+      Serial.print("  async ");
+      Serial.print(size);
+      Serial.println(": transferAsync() failed");
+      return;
+    }
+    while (!asyncDone)
+      idle++;
+    cycles += DWT_CYCCNT - start;
+    if (memcmp(rxBuf, txBuf, size) != 0)
+      ok = false;
+  }
+
+  uint32_t idleCycles = min((uint32_t)((uint64_t)idle * idleLoopCycles / 1000), cycles);
+  report("async", size, calls, calls * size, cycles, cycles - idleCycles, ok);
+}
+
+// Called by the core every millisecond, ends the calibration loop the way
+// the DMAC interrupt ends the one in asyncTest()
+extern "C" int sysTickHook(void) {
+  if (calibrateTicks && --calibrateTicks == 0)
+    asyncDone = true;
+  return 0;
+}
+
+// Runs the very loop of asyncTest() for 100 ms
+void calibrateIdleLoop() {
+  uint32_t idle = 0;
+
+  asyncDone = false;
+  calibrateTicks = 100;
+  uint32_t start = DWT_CYCCNT;
+  while (!asyncDone)
+    idle++;
+  idleLoopCycles = (uint64_t)(DWT_CYCCNT - start) * 1000 / idle;
+}
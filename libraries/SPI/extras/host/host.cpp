@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * Host build of the SPI library, simulated SPI0, DMAC and Cortex-M3 core.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#include "host.h"
+
+Spi hostSpi;
+Dmac hostDmac;
+Pio hostPio[4];
+const PinDescription g_APinDescription[92] = {};
+HostSpiStats hostStats;
+
+static uint32_t rdr;
+static bool rdrf;
+static volatile uint32_t primask;
+static volatile uint32_t ipsr;
+static void (*dmacCallbacks[DMACCH_NUM_NUMBER])(void);
+
+void hostReset(void) {
+	memset(&hostStats, 0, sizeof(hostStats));
+}
+
+// One frame on the bus. The chip select comes from TDR in variable
+// peripheral mode, from MR in fixed mode; its CSR gives the frame size.
+static uint32_t spiShift(uint32_t tdr) {
+	uint32_t pcs = (hostSpi.SPI_MR & SPI_MR_PS) ? tdr : hostSpi.SPI_MR;
+	uint32_t ch;
+
+	pcs = (pcs >> SPI_TDR_PCS_Pos) & 0xF;
+	for (ch = 0; ch < 3 && (pcs & (1 << ch)); ch++)
+		;
+	uint32_t bits = 8 + ((hostSpi.SPI_CSR[ch] & SPI_CSR_BITS_Msk) >> SPI_CSR_BITS_Pos);
+	uint32_t data = tdr & ((1 << bits) - 1);
+
+	// The caller counted this frame already
+	if (hostStats.polledFrames + hostStats.dmaFrames > 1 && ch != hostStats.channel)
+		hostStats.mixedChannels++;
+	hostStats.lastTdr = data;
+	hostStats.channel = ch;
+	hostStats.bits = bits;
+	if (tdr & SPI_TDR_LASTXFER)
+		hostStats.lastXfer++;
+
+	rdr = ~data & ((1 << bits) - 1);
+	rdrf = true;
+	return rdr;
+}
+
+SpiTdr &SpiTdr::operator=(uint32_t value) {
+	hostStats.polledFrames++;
+	spiShift(value);
+	return *this;
+}
+
+SpiRdr::operator uint32_t() {
+	rdrf = false;
+	return rdr;
+}
+
+// The shift register is always done, TXEMPTY and TDRE are always set
+SpiSr::operator uint32_t() {
+	return SPI_SR_TDRE | SPI_SR_TXEMPTY | (rdrf ? SPI_SR_RDRF : 0);
+}
+
+SpiCr &SpiCr::operator=(uint32_t value) {
+	if (value & SPI_CR_LASTXFER)
+		hostStats.lastXfer++;
+	return *this;
+}
+
+// Moves one block: a transmit channel (memory to peripheral) feeds TDR, a
+// receive channel collects RDR after each frame
+static void dmaRun(DmacCh_num *tx, DmacCh_num *rx) {
+	uint32_t count = tx->DMAC_CTRLA & DMAC_CTRLA_BTSIZE_Msk;
+	uint32_t unit = (tx->DMAC_CTRLA & DMAC_CTRLA_SRC_WIDTH_Msk) == DMAC_CTRLA_SRC_WIDTH_HALF_WORD ? 2 : 1;
+	uint8_t *src = (uint8_t *)(uintptr_t)tx->DMAC_SADDR;
+	uint8_t *dst = rx ? (uint8_t *)(uintptr_t)rx->DMAC_DADDR : NULL;
+	uint32_t srcStep = (tx->DMAC_CTRLB & DMAC_CTRLB_SRC_INCR_Msk) == DMAC_CTRLB_SRC_INCR_INCREMENTING ? unit : 0;
+	uint32_t dstStep = rx && (rx->DMAC_CTRLB & DMAC_CTRLB_DST_INCR_Msk) == DMAC_CTRLB_DST_INCR_INCREMENTING ? unit : 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t d = (unit == 2) ? *(uint16_t *)src : *src;
+		hostStats.dmaFrames++;
+		spiShift(d);
+		src += srcStep;
+		if (dst) {
+			rdrf = false;
+			if (unit == 2)
+				*(uint16_t *)dst = rdr;
+			else
+				*dst = rdr;
+			dst += dstStep;
+		}
+	}
+}
+
+// Runs the channels enabled by CHER to the end. Both must move the same
+// number of frames of the same size between memory and TDR/RDR; a channel
+// set up otherwise moves nothing but still completes, so nothing hangs.
+DmacCher &DmacCher::operator=(uint32_t value) {
+	DmacCh_num *tx = NULL, *rx = NULL;
+	uint32_t enable = value & 0x3F;
+
+	hostStats.dmaBlocks++;
+	for (uint32_t ch = 0; ch < DMACCH_NUM_NUMBER; ch++) {
+		if ((enable & (DMAC_CHER_ENA0 << ch)) == 0)
+			continue;
+		DmacCh_num *c = &hostDmac.DMAC_CH_NUM[ch];
+		if ((c->DMAC_CTRLB & DMAC_CTRLB_FC_Msk) == DMAC_CTRLB_FC_MEM2PER_DMA_FC)
+			tx = c;
+		else
+			rx = c;
+	}
+	if (!tx || !(hostDmac.DMAC_EN & DMAC_EN_ENABLE) ||
+			tx->DMAC_DADDR != (uint32_t)(uintptr_t)&hostSpi.SPI_TDR ||
+			(rx && rx->DMAC_SADDR != (uint32_t)(uintptr_t)&hostSpi.SPI_RDR) ||
+			(rx && rx->DMAC_CTRLA != tx->DMAC_CTRLA))
+		hostStats.dmaErrors++;
+	else
+		dmaRun(tx, rx);
+
+	hostDmac.DMAC_CHSR &= ~enable;
+	hostDmac.DMAC_EBCISR |= enable * DMAC_EBCISR_BTC0;
+	hostInterrupts();
+	return *this;
+}
+
+DmacIer &DmacIer::operator=(uint32_t value) {
+	hostDmac.DMAC_EBCIMR |= value;
+	hostInterrupts();
+	return *this;
+}
+
+DmacIdr &DmacIdr::operator=(uint32_t value) {
+	hostDmac.DMAC_EBCIMR &= ~value;
+	return *this;
+}
+
+// Same dispatch as dmacHook() in wiring_dmac.c
+void hostInterrupts(void) {
+	if (primask || ipsr)
+		return;
+	for (;;) {
+		uint32_t status = hostDmac.DMAC_EBCISR & hostDmac.DMAC_EBCIMR;
+		if (!status)
+			break;
+		// Reading the status clears it for all channels
+		hostDmac.DMAC_EBCISR = 0;
+		hostStats.interrupts++;
+		ipsr = DMAC_IRQn + 16;
+		for (uint32_t ch = 0; ch < DMACCH_NUM_NUMBER; ch++) {
+			uint32_t mask = (DMAC_EBCISR_BTC0 | DMAC_EBCISR_CBTC0 | DMAC_EBCISR_ERR0) << ch;
+			if ((status & mask) && dmacCallbacks[ch])
+				dmacCallbacks[ch]();
+		}
+		ipsr = 0;
+	}
+}
+
+void interrupts(void) {
+	primask = 0;
+	hostInterrupts();
+}
+
+void noInterrupts(void) {
+	primask = 1;
+}
+
+unsigned char hostInterruptsStatus(void) {
+	return primask ? 0 : 1;
+}
+
+uint32_t __get_IPSR(void) {
+	return ipsr;
+}
+
+uint32_t __RBIT(uint32_t value) {
+	uint32_t r = 0;
+	for (uint32_t i = 0; i < 32; i++, value >>= 1)
+		r = (r << 1) | (value & 1);
+	return r;
+}
+
+void dmacAttachInterrupt(uint32_t ulChannel, void (*callback)(void)) {
+	dmacCallbacks[ulChannel] = callback;
+}
+
+void dmacDetachInterrupt(uint32_t ulChannel) {
+	hostDmac.DMAC_EBCIMR &= ~((DMAC_EBCISR_BTC0 | DMAC_EBCISR_CBTC0 | DMAC_EBCISR_ERR0) << ulChannel);
+	dmacCallbacks[ulChannel] = NULL;
+}
+
+// The software reset clears the chip select registers
+void SPI_Configure(Spi *spi, uint32_t dwId, uint32_t dwConfiguration) {
+	(void)dwId;
+	spi->SPI_MR = dwConfiguration;
+	memset(spi->SPI_CSR, 0, sizeof(spi->SPI_CSR));
+	rdrf = false;
+}
+
+void SPI_Enable(Spi *spi) {
+	(void)spi;
+}
+
+void SPI_Disable(Spi *spi) {
+	(void)spi;
+}
+
+uint32_t pmc_enable_periph_clk(uint32_t ul_id) {
+	(void)ul_id;
+	return 0;
+}
+
+uint32_t PIO_Configure(Pio *pPio, uint32_t dwType, uint32_t dwMask, uint32_t dwAttribute) {
+	(void)pPio; (void)dwType; (void)dwMask; (void)dwAttribute;
+	return 1;
+}
+
+void pinMode(uint32_t ulPin, uint32_t ulMode) {
+	(void)ulPin; (void)ulMode;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * Host build of the SPI library, what the simulated SPI0 and DMAC saw.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include "variant.h"
+
+struct HostSpiStats {
+	uint32_t polledFrames;	// TDR written by the CPU
+	uint32_t dmaFrames;	// TDR written by the DMAC
+	uint32_t lastXfer;	// Chip select released, LASTXFER in TDR or CR
+	uint32_t lastTdr;	// Data field of the last frame sent
+	uint32_t channel;	// Chip select of the last frame
+	uint32_t bits;		// Frame size of the last frame
+	uint32_t mixedChannels;	// Frames on another chip select than the one before
+	uint32_t dmaBlocks;	// CHER writes
+	uint32_t dmaErrors;	// Channels set up against the wrong registers
+	uint32_t interrupts;	// DMAC interrupts taken
+};
+
+extern HostSpiStats hostStats;
+
+// Clears the counters, the simulated registers are left alone
+void hostReset(void);
+
+#endif
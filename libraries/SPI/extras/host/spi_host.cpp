@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * Host build of the SPI library: runs SPI.cpp against the simulated SPI0
+ * and DMAC of host.cpp and checks the data and the path every transfer
+ * took (polled, DMA, 9 to 16 bit frames, asynchronous jobs).
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include "SPI.h"
+#include "host.h"
+
+#define PIN 10	// BOARD_SPI_SS0, chip select 0
+
+static uint32_t failures;
+
+#define check(cond) do { \
+		if (!(cond)) { \
+			printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+// Buffers for the simulated DMAC, which has 32 bit addresses: globals
+// (linked with -no-pie) and the stack of runTests() are below 4 GB
+static uint8_t buf8[10000];
+static uint16_t buf16[6000];
+static uint8_t out8[10000];
+static uint16_t out16[6000];
+
+static void fill8(uint8_t *b, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		b[i] = (uint8_t)(i * 7 + 3);
+}
+
+static void fill16(uint16_t *b, size_t n, uint32_t bits) {
+	for (size_t i = 0; i < n; i++)
+		b[i] = (uint16_t)((i * 263 + 5) & ((1 << bits) - 1));
+}
+
+// The device answers every frame with its complement
+static bool inverted8(const uint8_t *rx, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		if (rx[i] != (uint8_t)~(uint8_t)(i * 7 + 3))
+			return false;
+	return true;
+}
+
+static bool inverted16(const uint16_t *rx, size_t n, uint32_t bits) {
+	uint32_t mask = (1 << bits) - 1;
+	for (size_t i = 0; i < n; i++)
+		if (rx[i] != (~((i * 263 + 5) & mask) & mask))
+			return false;
+	return true;
+}
+
+static bool all8(const uint8_t *b, size_t n, uint8_t v) {
+	for (size_t i = 0; i < n; i++)
+		if (b[i] != v)
+			return false;
+	return true;
+}
+
+static void testPolled(void) {
+	SPI.beginTransaction(PIN, SPISettings(4000000, MSBFIRST, SPI_MODE0));
+
+	hostReset();
+	check(SPI.transfer(PIN, 0x5A) == 0xA5);
+	check(hostStats.polledFrames == 1 && hostStats.lastXfer == 1);
+	check(hostStats.channel == 0 && hostStats.bits == 8);
+
+	// Up to the threshold buffers stay on the CPU
+	hostReset();
+	fill8(buf8, SPI_DMA_THRESHOLD);
+	SPI.transfer(PIN, buf8, SPI_DMA_THRESHOLD);
+	check(inverted8(buf8, SPI_DMA_THRESHOLD));
+	check(hostStats.polledFrames == SPI_DMA_THRESHOLD && hostStats.dmaFrames == 0);
+	check(hostStats.lastXfer == 1 && hostStats.mixedChannels == 0);
+
+	// SPI_CONTINUE keeps the chip select
+	hostReset();
+	SPI.transfer(PIN, 0x00, SPI_CONTINUE);
+	check(hostStats.lastXfer == 0);
+
+	// 8 bit frames, two per transfer16()
+	hostReset();
+	check(SPI.transfer16(PIN, 0x1234) == 0xEDCB);
+	check(hostStats.polledFrames == 2 && hostStats.lastXfer == 1);
+	SPI.endTransaction();
+
+	// LSBFIRST is reversed in software
+	SPI.beginTransaction(PIN, SPISettings(4000000, LSBFIRST, SPI_MODE0));
+	hostReset();
+	check(SPI.transfer(PIN, 0x01) == 0xFE);
+	check(hostStats.lastTdr == 0x80);
+
+	// and never takes the DMA path
+	hostReset();
+	fill8(buf8, 100);
+	SPI.transfer(PIN, buf8, 100);
+	check(inverted8(buf8, 100));
+	check(hostStats.polledFrames == 100 && hostStats.dmaFrames == 0);
+	SPI.endTransaction();
+}
+
+static void testDMA(void) {
+	SPI.beginTransaction(PIN, SPISettings(4000000, MSBFIRST, SPI_MODE0));
+	uint32_t mr = hostSpi.SPI_MR;
+	uint32_t csr = hostSpi.SPI_CSR[0];
+
+	// Over the threshold, the last frame is polled and releases the chip
+	// select
+	hostReset();
+	fill8(buf8, SPI_DMA_THRESHOLD + 1);
+	SPI.transfer(PIN, buf8, SPI_DMA_THRESHOLD + 1);
+	check(inverted8(buf8, SPI_DMA_THRESHOLD + 1));
+	check(hostStats.dmaFrames == SPI_DMA_THRESHOLD && hostStats.polledFrames == 1);
+	check(hostStats.lastXfer == 1 && hostStats.mixedChannels == 0 && hostStats.dmaErrors == 0);
+	check(hostSpi.SPI_MR == mr && hostSpi.SPI_CSR[0] == csr);
+
+	// Several DMAC blocks
+	hostReset();
+	fill8(buf8, sizeof(buf8));
+	SPI.transfer(PIN, buf8, sizeof(buf8));
+	check(inverted8(buf8, sizeof(buf8)));
+	check(hostStats.dmaBlocks == 3 && hostStats.dmaFrames == sizeof(buf8) - 1);
+	check(hostStats.lastXfer == 1 && hostStats.mixedChannels == 0 && hostStats.dmaErrors == 0);
+
+	// write() leaves the buffer alone
+	hostReset();
+	fill8(buf8, 1000);
+	SPI.write(PIN, buf8, 1000);
+	check(all8(buf8, 1, 3) && buf8[999] == (uint8_t)(999 * 7 + 3));
+	check(hostStats.dmaFrames == 999 && hostStats.lastXfer == 1 && hostStats.dmaErrors == 0);
+	check(hostStats.lastTdr == buf8[999]);
+
+	// read() sends the fill byte
+	hostReset();
+	SPI.read(PIN, buf8, 1000, 0x3C);
+	check(all8(buf8, 1000, 0xC3));
+	check(hostStats.dmaFrames == 999 && hostStats.lastXfer == 1 && hostStats.lastTdr == 0x3C);
+	check(hostSpi.SPI_MR == mr && hostSpi.SPI_CSR[0] == csr);
+	SPI.endTransaction();
+}
+
+static void testWide(void) {
+	for (uint32_t bits = 9; bits <= 16; bits++) {
+		SPI.beginTransaction(PIN, SPISettings(4000000, MSBFIRST, SPI_MODE0, bits));
+		uint32_t mask = (1 << bits) - 1;
+
+		// One frame per transfer16()
+		hostReset();
+		check(SPI.transfer16(PIN, 0x0ABC & mask) == (~0x0ABC & mask));
+		check(hostStats.polledFrames == 1 && hostStats.bits == bits);
+
+		hostReset();
+		fill16(buf16, SPI_DMA_THRESHOLD, bits);
+		SPI.transfer16(PIN, buf16, SPI_DMA_THRESHOLD);
+		check(inverted16(buf16, SPI_DMA_THRESHOLD, bits));
+		check(hostStats.polledFrames == SPI_DMA_THRESHOLD && hostStats.dmaFrames == 0);
+
+		hostReset();
+		fill16(buf16, 6000, bits);
+		SPI.transfer16(PIN, buf16, 6000);
+		check(inverted16(buf16, 6000, bits));
+		check(hostStats.dmaBlocks == 2 && hostStats.dmaFrames == 5999 && hostStats.polledFrames == 1);
+		check(hostStats.lastXfer == 1 && hostStats.dmaErrors == 0 && hostStats.bits == bits);
+
+		// Byte buffers hold uint16_t frames
+		hostReset();
+		fill16(buf16, 100, bits);
+		SPI.transfer(PIN, buf16, 200);
+		check(inverted16(buf16, 100, bits));
+		check(hostStats.dmaFrames == 99 && hostStats.polledFrames == 1);
+
+		hostReset();
+		fill16(buf16, 100, bits);
+		SPI.write(PIN, buf16, 200);
+		check(hostStats.dmaFrames == 99 && hostStats.lastTdr == buf16[99]);
+
+		hostReset();
+		SPI.read(PIN, buf16, 200, 0x00);
+		for (int i = 0; i < 100; i++)
+			check(buf16[i] == mask);
+		check(hostStats.dmaFrames == 99 && hostStats.lastXfer == 1);
+		SPI.endTransaction();
+	}
+}
+
+static volatile uint32_t callbacks;
+
+static void onDone(void) {
+	callbacks++;
+}
+
+static void testAsync(void) {
+	SPI.setDataMode(PIN, SPI_MODE0);
+	SPI.setBitOrder(PIN, MSBFIRST);
+	uint32_t csr = hostSpi.SPI_CSR[0];
+
+	// The interrupt is taken as soon as the job is queued
+	hostReset();
+	callbacks = 0;
+	fill8(buf8, 5000);
+	check(SPI.transferAsync(PIN, buf8, out8, 5000, onDone));
+	SPI.flush();
+	check(callbacks == 1 && !SPI.isBusy());
+	check(inverted8(out8, 5000));
+	check(hostStats.dmaFrames == 5000 && hostStats.polledFrames == 0 && hostStats.interrupts == 2);
+	check(hostStats.lastXfer == 1 && hostStats.dmaErrors == 0);
+	check(hostSpi.SPI_CSR[0] == csr);
+
+	// No transmit buffer sends 0xFF, no receive buffer drops the data
+	hostReset();
+	memset(out8, 0x55, 100);
+	check(SPI.transferAsync(PIN, NULL, out8, 100, onDone));
+	check(all8(out8, 100, 0x00) && hostStats.lastTdr == 0xFF);
+	fill8(buf8, 100);
+	check(SPI.transferAsync(PIN, buf8, NULL, 100, onDone, SPI_CONTINUE));
+	check(hostStats.lastTdr == buf8[99] && hostStats.lastXfer == 1);
+	check(callbacks == 3);
+
+	// Queued with interrupts disabled: the queue fills up, the jobs run
+	// one after the other once the interrupt comes in
+	hostReset();
+	noInterrupts();
+	for (int i = 0; i < SPI_ASYNC_QUEUE_SIZE; i++)
+		check(SPI.transferAsync(PIN, buf8, out8 + i * 100, 100, onDone));
+	check(!SPI.transferAsync(PIN, buf8, out8, 100, onDone));
+	check(SPI.isBusy() && callbacks == 3);
+	interrupts();
+	check(!SPI.isBusy() && callbacks == 3 + SPI_ASYNC_QUEUE_SIZE);
+	check(hostStats.lastXfer == SPI_ASYNC_QUEUE_SIZE);
+
+	// With interrupts disabled beginTransaction() completes the job itself
+	noInterrupts();
+	check(SPI.transferAsync(PIN, buf8, out8, 100, onDone));
+	check(SPI.isBusy());
+	SPI.beginTransaction(PIN, SPISettings(8000000, MSBFIRST, SPI_MODE0));
+	check(!SPI.isBusy() && callbacks == 4 + SPI_ASYNC_QUEUE_SIZE);
+	SPI.endTransaction();
+	interrupts();
+
+	// Jobs with their own settings, 12 bit frames. The pin keeps those of
+	// the last transaction.
+	csr = hostSpi.SPI_CSR[0];
+	hostReset();
+	fill16(buf16, 5000, 12);
+	check(SPI.transferAsync(PIN, SPISettings(4000000, MSBFIRST, SPI_MODE0, 12), buf16, out16, 5000, onDone));
+	check(inverted16(out16, 5000, 12));
+	check(hostStats.bits == 12 && hostStats.dmaFrames == 5000 && hostStats.dmaErrors == 0);
+	check(hostSpi.SPI_CSR[0] == csr);
+
+	// LSBFIRST is refused
+	SPI.setBitOrder(PIN, LSBFIRST);
+	check(!SPI.transferAsync(PIN, buf8, out8, 100));
+	SPI.setBitOrder(PIN, MSBFIRST);
+}
+
+static void runTests(void) {
+	SPI.begin(PIN);
+	testPolled();
+	testDMA();
+	testWide();
+	testAsync();
+	SPI.end();
+}
+
+int main(void) {
+	// The simulated DMAC gets 32 bit addresses of stack variables too
+	// (read() fill byte)
+	static ucontext_t mainContext, testContext;
+	size_t stackSize = 1 << 20;
+	void *stack = mmap(NULL, stackSize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if (stack == MAP_FAILED) {
+		perror("mmap");
+		return 2;
+	}
+	getcontext(&testContext);
+	testContext.uc_stack.ss_sp = stack;
+	testContext.uc_stack.ss_size = stackSize;
+	testContext.uc_link = &mainContext;
+	makecontext(&testContext, runTests, 0);
+	swapcontext(&mainContext, &testContext);
+
+	if (failures) {
+		printf("%u checks failed\n", failures);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
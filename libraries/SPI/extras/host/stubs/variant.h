@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * Host build of the SPI library, stand-in for the board headers.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _HOST_VARIANT_H_
+#define _HOST_VARIANT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Only the bit definitions of the real component headers, the register
+// blocks below replace their structures
+#define __ASSEMBLY__
+#include "component/component_spi.h"
+#include "component/component_dmac.h"
+#undef __ASSEMBLY__
+
+#define F_CPU 84000000L
+
+typedef uint8_t byte;
+enum BitOrder {
+	LSBFIRST = 0,
+	MSBFIRST = 1
+};
+#define INPUT 0x0
+#define min(a,b) ((a)<(b)?(a):(b))
+
+/*
+ * SPI0 register block. The MOSI line is looped back to MISO through an
+ * inverter: each frame written to TDR comes back in RDR complemented,
+ * cut to the frame size of the selected chip select.
+ */
+struct SpiTdr {
+	SpiTdr &operator=(uint32_t value);
+	operator uint32_t() const { return 0; }
+};
+struct SpiRdr {
+	operator uint32_t();
+};
+struct SpiSr {
+	operator uint32_t();
+};
+struct SpiCr {
+	SpiCr &operator=(uint32_t value);
+};
+typedef struct {
+	SpiCr    SPI_CR;
+	uint32_t SPI_MR;
+	SpiRdr   SPI_RDR;
+	SpiTdr   SPI_TDR;
+	SpiSr    SPI_SR;
+	uint32_t SPI_CSR[4];
+} Spi;
+
+/*
+ * DMA controller. Writing CHER runs the enabled channels to the end right
+ * away, moving the frames between memory and the SPI registers above. Its
+ * addresses are 32 bit like on the board, the buffers have to be below
+ * 4 GB (see spi_host.cpp).
+ */
+struct DmacCher {
+	DmacCher &operator=(uint32_t value);
+};
+typedef struct {
+	uint32_t DMAC_SADDR;
+	uint32_t DMAC_DADDR;
+	uint32_t DMAC_DSCR;
+	uint32_t DMAC_CTRLA;
+	uint32_t DMAC_CTRLB;
+	uint32_t DMAC_CFG;
+} DmacCh_num;
+struct DmacIer {
+	DmacIer &operator=(uint32_t value);
+};
+struct DmacIdr {
+	DmacIdr &operator=(uint32_t value);
+};
+#define DMACCH_NUM_NUMBER 6
+typedef struct {
+	uint32_t   DMAC_GCFG;
+	uint32_t   DMAC_EN;
+	DmacIer    DMAC_EBCIER;
+	DmacIdr    DMAC_EBCIDR;
+	uint32_t   DMAC_EBCIMR;
+	uint32_t   DMAC_EBCISR;
+	DmacCher   DMAC_CHER;
+	uint32_t   DMAC_CHSR;
+	DmacCh_num DMAC_CH_NUM[DMACCH_NUM_NUMBER];
+} Dmac;
+
+extern Spi hostSpi;
+extern Dmac hostDmac;
+#define SPI0    (&hostSpi)
+#define DMAC    (&hostDmac)
+#define ID_SPI0 24
+#define ID_DMAC 39
+#define DMAC_IRQn 39
+
+// libsam
+#define SPI_PCS(npcs) ((~(1 << (npcs)) & 0xF) << 16)
+void SPI_Configure(Spi *spi, uint32_t dwId, uint32_t dwConfiguration);
+void SPI_Enable(Spi *spi);
+void SPI_Disable(Spi *spi);
+uint32_t pmc_enable_periph_clk(uint32_t ul_id);
+
+// Parallel I/O, only the interrupt masks are touched
+typedef struct {
+	uint32_t PIO_IER;
+	uint32_t PIO_IDR;
+} Pio;
+extern Pio hostPio[4];
+#define PIOA (&hostPio[0])
+#define PIOB (&hostPio[1])
+#define PIOC (&hostPio[2])
+#define PIOD (&hostPio[3])
+#define PIO_PERIPH_A 1
+#define PIO_DEFAULT  0
+typedef struct {
+	Pio *pPort;
+	uint32_t ulPinType;
+	uint32_t ulPin;
+	uint32_t ulPinConfiguration;
+} PinDescription;
+extern const PinDescription g_APinDescription[];
+uint32_t PIO_Configure(Pio *pPio, uint32_t dwType, uint32_t dwMask, uint32_t dwAttribute);
+void pinMode(uint32_t ulPin, uint32_t ulMode);
+
+// Cortex-M3 core: PRIMASK and the active exception, see hostInterrupts()
+void interrupts(void);
+void noInterrupts(void);
+#define interruptsStatus() hostInterruptsStatus()
+unsigned char hostInterruptsStatus(void);
+uint32_t __get_IPSR(void);
+uint32_t __RBIT(uint32_t value);
+
+// wiring_dmac
+void dmacAttachInterrupt(uint32_t ulChannel, void (*callback)(void));
+void dmacDetachInterrupt(uint32_t ulChannel);
+
+// Runs the DMAC interrupt while one is pending and enabled, as the NVIC
+// would. Called whenever a register write or interrupts() may let it in,
+// so busy loops never wait for it.
+void hostInterrupts(void);
+
+/*
+ * SPI Interfaces
+ */
+#define SPI_INTERFACES_COUNT 1
+
+#define SPI_INTERFACE        SPI0
+#define SPI_INTERFACE_ID     ID_SPI0
+#define SPI_CHANNELS_NUM 4
+#define PIN_SPI_SS0          (77u)
+#define PIN_SPI_SS1          (87u)
+#define PIN_SPI_SS2          (86u)
+#define PIN_SPI_SS3          (78u)
+#define PIN_SPI_MOSI         (75u)
+#define PIN_SPI_MISO         (74u)
+#define PIN_SPI_SCK          (76u)
+#define BOARD_SPI_SS0        (10u)
+#define BOARD_SPI_SS1        (4u)
+#define BOARD_SPI_SS2        (52u)
+#define BOARD_SPI_SS3        PIN_SPI_SS3
+#define BOARD_SPI_DEFAULT_SS BOARD_SPI_SS3
+
+#define BOARD_PIN_TO_SPI_PIN(x) \
+	(x==BOARD_SPI_SS0 ? PIN_SPI_SS0 : \
+	(x==BOARD_SPI_SS1 ? PIN_SPI_SS1 : \
+	(x==BOARD_SPI_SS2 ? PIN_SPI_SS2 : PIN_SPI_SS3 )))
+#define BOARD_PIN_TO_SPI_CHANNEL(x) \
+	(x==BOARD_SPI_SS0 ? 0 : \
+	(x==BOARD_SPI_SS1 ? 1 : \
+	(x==BOARD_SPI_SS2 ? 2 : 3)))
+
+#define NUM_DIGITAL_PINS 66
+
+#endif
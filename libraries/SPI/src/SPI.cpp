@@ -11,8 +11,129 @@
 
 #include "SPI.h"
 
+// DMA controller channels and the SPI0 hardware handshaking interfaces
+// used by buffer transfers. RX gets the higher priority, so that received
+// bytes are fetched before the next one arrives.
+#define SPI_DMAC_TX_CH		0
+#define SPI_DMAC_RX_CH		1
+#define SPI_DMAC_TX_PER		1
+#define SPI_DMAC_RX_PER		2
+// Largest block the DMAC moves with one descriptor (BTSIZE)
+#define SPI_DMAC_MAX_BLOCK	4095
+
+#define SPI_JOB_QUEUE		(SPI_ASYNC_QUEUE_SIZE + 1)
+
+// Sent when there is no transmit buffer, received data goes to the bin
+// when there is no receive buffer. Wide enough for 16 bit frames. Both
+// stay in SRAM, the DMAC reads the fill word as a source.
+static uint16_t dmaFill = 0xFFFF;
+static uint16_t dmaDiscard;
+
+// The DMAC channels are fixed, so is their owner
+static SPIClass *dmacOwner;
+
+static void SPI_DmacHandler(void) {
+	if (dmacOwner)
+		dmacOwner->onDmacInterrupt();
+}
+
+// The SPI controller only shifts MSB first, LSBFIRST frames are reversed
+// in software. The bit order is a template parameter of the polled loops
+// below, so MSBFIRST code carries neither the reversal nor a test for it.
+template <BitOrder order>
+static inline uint32_t SPI_Reverse(uint32_t d, uint32_t bits) {
+	return (order == LSBFIRST) ? __RBIT(d) >> (32 - bits) : d;
+}
+
+template <BitOrder order>
+static inline uint32_t SPI_TransferFrame(Spi *spi, uint32_t ch, uint32_t bits, uint32_t data, SPITransferMode mode) {
+	uint32_t d = SPI_Reverse<order>(data, bits) | SPI_PCS(ch);
+	if (mode == SPI_LAST)
+		d |= SPI_TDR_LASTXFER;
+
+	while ((spi->SPI_SR & SPI_SR_TDRE) == 0)
+		;
+	spi->SPI_TDR = d;
+
+	while ((spi->SPI_SR & SPI_SR_RDRF) == 0)
+		;
+	return SPI_Reverse<order>(spi->SPI_RDR & SPI_RDR_RD_Msk, bits);
+}
+
+// Polled buffer transfer of 8 bit (uint8_t) or wider (uint16_t) frames.
+// txStep 0 sends the same frame over and over; without rx the received
+// data is dropped.
+template <BitOrder order, typename T>
+static void SPI_TransferBuffer(Spi *spi, uint32_t ch, uint32_t bits, const T *tx, size_t txStep, T *rx, size_t count, SPITransferMode mode) {
+	uint32_t pcs = SPI_PCS(ch);
+
+	if (!rx) {
+		// Keep TDR filled, nothing is read back
+		while (count > 0) {
+			uint32_t d = SPI_Reverse<order>(*tx, bits) | pcs;
+			tx += txStep;
+			if (count == 1 && mode == SPI_LAST)
+				d |= SPI_TDR_LASTXFER;
+			while ((spi->SPI_SR & SPI_SR_TDRE) == 0)
+				;
+			spi->SPI_TDR = d;
+			count--;
+		}
+
+		// Wait for the last frame, then drop the received data and the
+		// overrun flag (cleared by reading the status)
+		while ((spi->SPI_SR & SPI_SR_TXEMPTY) == 0)
+			;
+		spi->SPI_RDR;
+		spi->SPI_SR;
+		return;
+	}
+
+	// Send the first frame
+	uint32_t d = SPI_Reverse<order>(*tx, bits) | pcs;
+	tx += txStep;
+	if (count == 1 && mode == SPI_LAST)
+		d |= SPI_TDR_LASTXFER;
+	while ((spi->SPI_SR & SPI_SR_TDRE) == 0)
+		;
+	spi->SPI_TDR = d;
+
+	while (count > 1) {
+		// Prepare next frame
+		d = SPI_Reverse<order>(*tx, bits) | pcs;
+		tx += txStep;
+		if (count == 2 && mode == SPI_LAST)
+			d |= SPI_TDR_LASTXFER;
+
+		// Read transferred frame and send next one straight away
+		while ((spi->SPI_SR & SPI_SR_RDRF) == 0)
+			;
+		uint32_t r = spi->SPI_RDR & SPI_RDR_RD_Msk;
+		spi->SPI_TDR = d;
+
+		// Save read frame
+		*rx++ = SPI_Reverse<order>(r, bits);
+		count--;
+	}
+
+	// Receive the last transferred frame
+	while ((spi->SPI_SR & SPI_SR_RDRF) == 0)
+		;
+	*rx = SPI_Reverse<order>(spi->SPI_RDR & SPI_RDR_RD_Msk, bits);
+}
+
+template <typename T>
+static void SPI_TransferBuffer(Spi *spi, BitOrder order, uint32_t ch, uint32_t bits, const T *tx, size_t txStep, T *rx, size_t count, SPITransferMode mode) {
+	if (order == LSBFIRST)
+		SPI_TransferBuffer<LSBFIRST, T>(spi, ch, bits, tx, txStep, rx, count, mode);
+	else
+		SPI_TransferBuffer<MSBFIRST, T>(spi, ch, bits, tx, txStep, rx, count, mode);
+}
+
 SPIClass::SPIClass(Spi *_spi, uint32_t _id, void(*_initCb)(void)) :
-	spi(_spi), id(_id), initCb(_initCb), initialized(false)
+	spi(_spi), id(_id), initCb(_initCb), initialized(false),
+	jobHead(0), jobTail(0), jobActive(false), heldHead(0), heldTail(0),
+	inTransaction(false)
 {
 	// Empty
 }
@@ -53,8 +174,16 @@ void SPIClass::init() {
 	interruptMask[2] = 0;
 	interruptMask[3] = 0;
 	initCb();
+	// The software reset clears the chip select registers
 	SPI_Configure(spi, id, SPI_MR_MSTR | SPI_MR_PS | SPI_MR_MODFDIS);
+	for (uint32_t ch = 0; ch < SPI_CHANNELS_NUM; ch++)
+		csrCache[ch] = 0;
 	SPI_Enable(spi);
+	pmc_enable_periph_clk(ID_DMAC);
+	DMAC->DMAC_GCFG = DMAC_GCFG_ARB_CFG_FIXED;
+	DMAC->DMAC_EN = DMAC_EN_ENABLE;
+	dmacOwner = this;
+	dmacAttachInterrupt(SPI_DMAC_RX_CH, SPI_DmacHandler);
 	initialized = true;
 }
 
@@ -105,6 +234,24 @@ void SPIClass::usingInterrupt(uint8_t interruptNumber)
 
 void SPIClass::beginTransaction(uint8_t pin, SPISettings settings)
 {
+	// Take the bus once the queued transfers are done. From here on jobs
+	// queued by interrupt handlers wait for endTransaction(). An interrupt
+	// handler, or code with interrupts disabled, can not wait for the DMAC
+	// interrupt and completes the jobs itself.
+	bool poll = __get_IPSR() != 0 || !interruptsStatus();
+	for (;;) {
+		uint8_t irestore = interruptsStatus();
+		noInterrupts();
+		if (poll)
+			pollJob();
+		bool idle = !jobActive;
+		if (idle)
+			inTransaction = true;
+		if (irestore) interrupts();
+		if (idle)
+			break;
+	}
+
 	uint8_t mode = interruptMode;
 	if (mode > 0) {
 		if (mode < 16) {
@@ -119,7 +266,10 @@ void SPIClass::beginTransaction(uint8_t pin, SPISettings settings)
 	}
 	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(pin);
 	bitOrder[ch] = settings.border;
-	SPI_ConfigureNPCS(spi, ch, settings.config);
+	// Most transactions reuse the settings of the previous one, the copy in
+	// RAM saves the peripheral access
+	if (csrCache[ch] != settings.config)
+		writeCSR(ch, settings.config);
 	//setBitOrder(pin, settings.border);
 	//setDataMode(pin, settings.datamode);
 	//setClockDivider(pin, settings.clockdiv);
@@ -138,6 +288,12 @@ void SPIClass::endTransaction(void)
 			if (interruptSave) interrupts();
 		}
 	}
+
+	uint8_t irestore = interruptsStatus();
+	noInterrupts();
+	inTransaction = false;
+	releaseHeld();
+	if (irestore) interrupts();
 }
 
 void SPIClass::end(uint8_t _pin) {
@@ -147,58 +303,58 @@ void SPIClass::end(uint8_t _pin) {
 }
 
 void SPIClass::end() {
+	flush();
+	dmacDetachInterrupt(SPI_DMAC_RX_CH);
 	SPI_Disable(spi);
 	initialized = false;
 }
 
 void SPIClass::setBitOrder(uint8_t _pin, BitOrder _bitOrder) {
+	flush();
 	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
 	bitOrder[ch] = _bitOrder;
 }
 
 void SPIClass::setDataMode(uint8_t _pin, uint8_t _mode) {
+	flush();
 	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
 	mode[ch] = _mode | SPI_CSR_CSAAT;
 	// SPI_CSR_DLYBCT(1) keeps CS enabled for 32 MCLK after a completed
 	// transfer. Some device needs that for working properly.
-	SPI_ConfigureNPCS(spi, ch, mode[ch] | SPI_CSR_SCBR(divider[ch]) | SPI_CSR_DLYBCT(1));
+	writeCSR(ch, mode[ch] | SPI_CSR_SCBR(divider[ch]) | SPI_CSR_DLYBCT(1));
 }
 
 void SPIClass::setClockDivider(uint8_t _pin, uint8_t _divider) {
+	flush();
 	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
 	divider[ch] = _divider;
 	// SPI_CSR_DLYBCT(1) keeps CS enabled for 32 MCLK after a completed
 	// transfer. Some device needs that for working properly.
-	SPI_ConfigureNPCS(spi, ch, mode[ch] | SPI_CSR_SCBR(divider[ch]) | SPI_CSR_DLYBCT(1));
+	writeCSR(ch, mode[ch] | SPI_CSR_SCBR(divider[ch]) | SPI_CSR_DLYBCT(1));
 }
 
 byte SPIClass::transfer(byte _pin, uint8_t _data, SPITransferMode _mode) {
+	flush();
 	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
-	// Reverse bit order
-	if (bitOrder[ch] == LSBFIRST)
-		_data = __REV(__RBIT(_data));
-	uint32_t d = _data | SPI_PCS(ch);
-	if (_mode == SPI_LAST)
-		d |= SPI_TDR_LASTXFER;
-
-	// SPI_Write(spi, _channel, _data);
-	while ((spi->SPI_SR & SPI_SR_TDRE) == 0)
-		;
-	spi->SPI_TDR = d;
-
-	// return SPI_Read(spi);
-	while ((spi->SPI_SR & SPI_SR_RDRF) == 0)
-		;
-	d = spi->SPI_RDR;
-	// Reverse bit order
 	if (bitOrder[ch] == LSBFIRST)
-		d = __REV(__RBIT(d));
-	return d & 0xFF;
+		return SPI_TransferFrame<LSBFIRST>(spi, ch, 8, _data, _mode) & 0xFF;
+	return SPI_TransferFrame<MSBFIRST>(spi, ch, 8, _data, _mode) & 0xFF;
 }
 
 uint16_t SPIClass::transfer16(byte _pin, uint16_t _data, SPITransferMode _mode) {
-	union { uint16_t val; struct { uint8_t lsb; uint8_t msb; }; } t;
+	flush();
 	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
+	uint32_t bits = frameBits(ch);
+
+	// One frame of 9 to 16 bits
+	if (bits > 8) {
+		if (bitOrder[ch] == LSBFIRST)
+			return SPI_TransferFrame<LSBFIRST>(spi, ch, bits, _data, _mode);
+		return SPI_TransferFrame<MSBFIRST>(spi, ch, bits, _data, _mode);
+	}
+
+	// Two 8 bit frames
+	union { uint16_t val; struct { uint8_t lsb; uint8_t msb; }; } t;
 
 	t.val = _data;
 
@@ -213,56 +369,353 @@ uint16_t SPIClass::transfer16(byte _pin, uint16_t _data, SPITransferMode _mode)
 	return t.val;
 }
 
+void SPIClass::transfer16(byte _pin, uint16_t *_buf, size_t _count, SPITransferMode _mode) {
+	if (_count == 0)
+		return;
+	flush();
+
+	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
+	uint32_t bits = frameBits(ch);
+	if (bits == 8) {
+		for (; _count > 1; _count--, _buf++)
+			*_buf = transfer16(_pin, *_buf, SPI_CONTINUE);
+		*_buf = transfer16(_pin, *_buf, _mode);
+		return;
+	}
+
+	if (bitOrder[ch] != LSBFIRST && _count > SPI_DMA_THRESHOLD) {
+		transferDMA(ch, _buf, true, _buf, _count - 1, 2);
+		_buf += _count - 1;
+		_count = 1;
+	}
+	SPI_TransferBuffer<uint16_t>(spi, bitOrder[ch], ch, bits, _buf, 1, _buf, _count, _mode);
+}
+
+void SPIClass::write16(byte _pin, const uint16_t *_buf, size_t _count, SPITransferMode _mode) {
+	if (_count == 0)
+		return;
+	flush();
+
+	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
+	uint32_t bits = frameBits(ch);
+	if (bits == 8) {
+		for (; _count > 1; _count--, _buf++)
+			transfer16(_pin, *_buf, SPI_CONTINUE);
+		transfer16(_pin, *_buf, _mode);
+		return;
+	}
+
+	if (bitOrder[ch] != LSBFIRST && _count > SPI_DMA_THRESHOLD) {
+		transferDMA(ch, _buf, true, NULL, _count - 1, 2);
+		_buf += _count - 1;
+		_count = 1;
+	}
+	SPI_TransferBuffer<uint16_t>(spi, bitOrder[ch], ch, bits, _buf, 1, NULL, _count, _mode);
+}
+
+// Long buffers go through the DMA controller. The last frame always takes
+// the polled path, that is where _mode releases the chip select.
 void SPIClass::transfer(byte _pin, void *_buf, size_t _count, SPITransferMode _mode) {
 	if (_count == 0)
 		return;
+	flush();
 
 	uint8_t *buffer = (uint8_t *)_buf;
-	if (_count == 1) {
-		*buffer = transfer(_pin, *buffer, _mode);
+	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
+
+	// Wide frames: the bytes hold uint16_t frames
+	if (frameBits(ch) > 8) {
+		transfer16(_pin, (uint16_t *)_buf, _count / 2, _mode);
 		return;
 	}
 
+	if (bitOrder[ch] != LSBFIRST && _count > SPI_DMA_THRESHOLD) {
+		transferDMA(ch, buffer, true, buffer, _count - 1, 1);
+		buffer += _count - 1;
+		_count = 1;
+	}
+	SPI_TransferBuffer<uint8_t>(spi, bitOrder[ch], ch, 8, buffer, 1, buffer, _count, _mode);
+}
+
+void SPIClass::write(byte _pin, const void *_buf, size_t _count, SPITransferMode _mode) {
+	if (_count == 0)
+		return;
+	flush();
+
+	const uint8_t *buffer = (const uint8_t *)_buf;
 	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
-	bool reverse = (bitOrder[ch] == LSBFIRST);
 
-	// Send the first byte
-	uint32_t d = *buffer;
-	if (reverse)
-		d = __REV(__RBIT(d));
-	while ((spi->SPI_SR & SPI_SR_TDRE) == 0)
-		;
-	spi->SPI_TDR = d | SPI_PCS(ch);
-
-	while (_count > 1) {
-		// Prepare next byte
-		d = *(buffer+1);
-		if (reverse)
-			d = __REV(__RBIT(d));
-		if (_count == 2 && _mode == SPI_LAST)
-			d |= SPI_TDR_LASTXFER;
+	if (frameBits(ch) > 8) {
+		write16(_pin, (const uint16_t *)_buf, _count / 2, _mode);
+		return;
+	}
 
-		// Read transferred byte and send next one straight away
-		while ((spi->SPI_SR & SPI_SR_RDRF) == 0)
+	if (bitOrder[ch] != LSBFIRST && _count > SPI_DMA_THRESHOLD) {
+		transferDMA(ch, buffer, true, NULL, _count - 1, 1);
+		buffer += _count - 1;
+		_count = 1;
+	}
+	SPI_TransferBuffer<uint8_t>(spi, bitOrder[ch], ch, 8, buffer, 1, NULL, _count, _mode);
+}
+
+void SPIClass::read(byte _pin, void *_buf, size_t _count, uint8_t _fill, SPITransferMode _mode) {
+	if (_count == 0)
+		return;
+	flush();
+
+	uint8_t *buffer = (uint8_t *)_buf;
+	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
+
+	if (frameBits(ch) > 8) {
+		memset(_buf, _fill, _count);
+		transfer16(_pin, (uint16_t *)_buf, _count / 2, _mode);
+		return;
+	}
+
+	if (bitOrder[ch] != LSBFIRST && _count > SPI_DMA_THRESHOLD) {
+		transferDMA(ch, &_fill, false, buffer, _count - 1, 1);
+		buffer += _count - 1;
+		_count = 1;
+	}
+	SPI_TransferBuffer<uint8_t>(spi, bitOrder[ch], ch, 8, &_fill, 0, buffer, _count, _mode);
+}
+
+// Without a receive buffer only the transmit channel runs, the received
+// data is dropped at the end. _unit is the size of a frame in memory, 1 for
+// 8 bit frames and 2 for wider ones.
+void SPIClass::transferDMA(uint32_t _ch, const void *_txBuf, bool _txIncr, void *_rxBuf, size_t _count, uint32_t _unit) {
+	const uint8_t *tx = (const uint8_t *)_txBuf;
+	uint8_t *rx = (uint8_t *)_rxBuf;
+	uint32_t config = csrCache[_ch];
+	dmaBegin(_ch, config);
+	while (_count > 0) {
+		uint32_t n = min(_count, (size_t)SPI_DMAC_MAX_BLOCK);
+		dmaStart(tx, _txIncr, rx, true, n, _unit);
+		if (rx) {
+			while (DMAC->DMAC_CHSR & (DMAC_CHSR_ENA0 << SPI_DMAC_RX_CH))
+				;
+			rx += n * _unit;
+		} else {
+			while (DMAC->DMAC_CHSR & (DMAC_CHSR_ENA0 << SPI_DMAC_TX_CH))
+				;
+		}
+		if (_txIncr)
+			tx += n * _unit;
+		_count -= n;
+	}
+	if (!_rxBuf) {
+		while ((spi->SPI_SR & SPI_SR_TXEMPTY) == 0)
 			;
-		uint8_t r = spi->SPI_RDR;
-		spi->SPI_TDR = d | SPI_PCS(ch);
-
-		// Save read byte
-		if (reverse)
-			r = __REV(__RBIT(r));
-		*buffer = r;
-		buffer++;
-		_count--;
+		spi->SPI_RDR;
+		spi->SPI_SR;
 	}
+	dmaEnd(_ch, config);
+}
 
-	// Receive the last transferred byte
-	while ((spi->SPI_SR & SPI_SR_RDRF) == 0)
+void SPIClass::dmaBegin(uint32_t _ch, uint32_t _config) {
+	// Let pending transfers finish and drop stale data
+	while ((spi->SPI_SR & SPI_SR_TXEMPTY) == 0)
 		;
-	uint8_t r = spi->SPI_RDR;
-	if (reverse)
-		r = __REV(__RBIT(r));
-	*buffer = r;
+	spi->SPI_RDR;
+
+	// The DMAC writes TDR one frame at a time, without the PCS field. Select
+	// the chip in the mode register (fixed peripheral) meanwhile, and skip
+	// the delay between consecutive bytes.
+	spi->SPI_MR = (spi->SPI_MR & ~(SPI_MR_PS | SPI_MR_PCS_Msk)) | SPI_PCS(_ch);
+	writeCSR(_ch, _config & ~SPI_CSR_DLYBCT_Msk);
+}
+
+void SPIClass::dmaEnd(uint32_t _ch, uint32_t _config) {
+	writeCSR(_ch, _config);
+	spi->SPI_MR = (spi->SPI_MR & ~SPI_MR_PCS_Msk) | SPI_MR_PS;
+}
+
+// The receive channel is left alone if _rxBuf is NULL. A buffer that is
+// not incremented sends or collects the same frame over and over.
+void SPIClass::dmaStart(const void *_txBuf, bool _txIncr, void *_rxBuf, bool _rxIncr, size_t _count, uint32_t _unit) {
+	uint32_t enable = DMAC_CHER_ENA0 << SPI_DMAC_TX_CH;
+	uint32_t width = (_unit == 2) ?
+			DMAC_CTRLA_SRC_WIDTH_HALF_WORD | DMAC_CTRLA_DST_WIDTH_HALF_WORD :
+			DMAC_CTRLA_SRC_WIDTH_BYTE | DMAC_CTRLA_DST_WIDTH_BYTE;
+
+	// RX is set up first, it must be ready for the first byte
+	if (_rxBuf) {
+		DmacCh_num *rx = &DMAC->DMAC_CH_NUM[SPI_DMAC_RX_CH];
+		rx->DMAC_SADDR = (uint32_t)&spi->SPI_RDR;
+		rx->DMAC_DADDR = (uint32_t)_rxBuf;
+		rx->DMAC_DSCR = 0;
+		rx->DMAC_CTRLA = _count | width;
+		rx->DMAC_CTRLB = DMAC_CTRLB_SRC_DSCR_FETCH_DISABLE | DMAC_CTRLB_DST_DSCR_FETCH_DISABLE |
+				DMAC_CTRLB_FC_PER2MEM_DMA_FC | DMAC_CTRLB_SRC_INCR_FIXED |
+				(_rxIncr ? DMAC_CTRLB_DST_INCR_INCREMENTING : DMAC_CTRLB_DST_INCR_FIXED);
+		rx->DMAC_CFG = DMAC_CFG_SRC_PER(SPI_DMAC_RX_PER) | DMAC_CFG_SRC_H2SEL_HW |
+				DMAC_CFG_SOD_ENABLE | DMAC_CFG_FIFOCFG_ASAP_CFG;
+		enable |= DMAC_CHER_ENA0 << SPI_DMAC_RX_CH;
+	}
+
+	DmacCh_num *tx = &DMAC->DMAC_CH_NUM[SPI_DMAC_TX_CH];
+	tx->DMAC_SADDR = (uint32_t)_txBuf;
+	tx->DMAC_DADDR = (uint32_t)&spi->SPI_TDR;
+	tx->DMAC_DSCR = 0;
+	tx->DMAC_CTRLA = _count | width;
+	tx->DMAC_CTRLB = DMAC_CTRLB_SRC_DSCR_FETCH_DISABLE | DMAC_CTRLB_DST_DSCR_FETCH_DISABLE |
+			DMAC_CTRLB_FC_MEM2PER_DMA_FC | DMAC_CTRLB_DST_INCR_FIXED |
+			(_txIncr ? DMAC_CTRLB_SRC_INCR_INCREMENTING : DMAC_CTRLB_SRC_INCR_FIXED);
+	tx->DMAC_CFG = DMAC_CFG_DST_PER(SPI_DMAC_TX_PER) | DMAC_CFG_DST_H2SEL_HW |
+			DMAC_CFG_SOD_ENABLE | DMAC_CFG_FIFOCFG_ALAP_CFG;
+
+	DMAC->DMAC_CHER = enable;
+}
+
+bool SPIClass::transferAsync(byte _pin, const void *_txBuf, void *_rxBuf, size_t _count, void (*_callback)(void), SPITransferMode _mode) {
+	uint32_t ch = BOARD_PIN_TO_SPI_CHANNEL(_pin);
+	if (bitOrder[ch] == LSBFIRST)
+		return false;
+	return queueJob(ch, NULL, _txBuf, _rxBuf, _count, _callback, _mode);
+}
+
+bool SPIClass::transferAsync(byte _pin, SPISettings settings, const void *_txBuf, void *_rxBuf, size_t _count, void (*_callback)(void), SPITransferMode _mode) {
+	if (settings.border == LSBFIRST)
+		return false;
+	return queueJob(BOARD_PIN_TO_SPI_CHANNEL(_pin), &settings.config, _txBuf, _rxBuf, _count, _callback, _mode);
+}
+
+bool SPIClass::queueJob(uint32_t _ch, const uint32_t *_config, const void *_txBuf, void *_rxBuf, size_t _count, void (*_callback)(void), SPITransferMode _mode) {
+	if (_count == 0)
+		return false;
+
+	uint8_t irestore = interruptsStatus();
+	noInterrupts();
+
+	// Interrupt handlers must not cut into an open transaction, their jobs
+	// are held back until it ends. Callbacks of finished jobs (DMAC
+	// interrupt) belong to the same user and go straight to the queue.
+	uint32_t ipsr = __get_IPSR();
+	bool hold = inTransaction && ipsr != 0 && ipsr != (uint32_t)DMAC_IRQn + 16;
+	Job *ring = hold ? heldJobs : jobs;
+	volatile uint8_t &head = hold ? heldHead : jobHead;
+
+	uint8_t next = (head + 1) % SPI_JOB_QUEUE;
+	if (next == (hold ? heldTail : jobTail)) {
+		if (irestore) interrupts();
+		return false;
+	}
+
+	Job &job = ring[head];
+	job.txBuf = (const uint8_t *)_txBuf;
+	job.rxBuf = (uint8_t *)_rxBuf;
+	job.count = _count;
+	job.ch = _ch;
+	job.mode = _mode;
+	job.callback = _callback;
+	if (_config) {
+		job.config = *_config;
+	} else if (jobActive && jobs[jobTail].ch == _ch) {
+		// The running job has replaced the register, it restores this
+		job.config = jobs[jobTail].restore;
+	} else {
+		job.config = csrCache[_ch];
+	}
+	head = next;
+
+	if (!hold && !jobActive)
+		startJob();
+
+	if (irestore) interrupts();
+	return true;
+}
+
+// Called with interrupts disabled or from the DMAC interrupt
+void SPIClass::startJob(void) {
+	Job &job = jobs[jobTail];
+	jobActive = true;
+	jobDone = 0;
+	jobUnit = (job.config & SPI_CSR_BITS_Msk) == SPI_CSR_BITS_8_BIT ? 1 : 2;
+	dmacOwner = this;
+	// The settings of the pin come back when the job is done
+	job.restore = csrCache[job.ch];
+	dmaBegin(job.ch, job.config);
+	startBlock();
+}
+
+void SPIClass::startBlock(void) {
+	Job &job = jobs[jobTail];
+	jobBlock = min(job.count - jobDone, (size_t)SPI_DMAC_MAX_BLOCK);
+	// The receive channel always runs, its completion ends the block
+	size_t offset = jobDone * jobUnit;
+	dmaStart(job.txBuf ? job.txBuf + offset : (const uint8_t *)&dmaFill, job.txBuf != NULL,
+			job.rxBuf ? job.rxBuf + offset : (uint8_t *)&dmaDiscard, job.rxBuf != NULL, jobBlock, jobUnit);
+	DMAC->DMAC_EBCIER = DMAC_EBCIER_BTC0 << SPI_DMAC_RX_CH;
+}
+
+void SPIClass::onDmacInterrupt(void) {
+	// Completion flags left over by synchronous transfers end up here too
+	if (!jobActive || (DMAC->DMAC_CHSR & (DMAC_CHSR_ENA0 << SPI_DMAC_RX_CH)))
+		return;
+
+	Job &job = jobs[jobTail];
+	jobDone += jobBlock;
+	if (jobDone < job.count) {
+		startBlock();
+		return;
+	}
+
+	DMAC->DMAC_EBCIDR = DMAC_EBCIDR_BTC0 << SPI_DMAC_RX_CH;
+	// Everything has been shifted out, release the chip select right away
+	if (job.mode == SPI_LAST)
+		spi->SPI_CR = SPI_CR_LASTXFER;
+	dmaEnd(job.ch, job.restore);
+
+	// The callback may queue more jobs or use the bus synchronously
+	void (*callback)(void) = job.callback;
+	jobTail = (jobTail + 1) % SPI_JOB_QUEUE;
+	jobActive = false;
+	if (callback)
+		callback();
+	if (!inTransaction)
+		releaseHeld();
+	else if (!jobActive && jobTail != jobHead)
+		startJob();
+}
+
+// Moves held jobs to the queue as far as it has room and starts the next
+// job. Called with interrupts disabled or from the DMAC interrupt.
+void SPIClass::releaseHeld(void) {
+	while (heldTail != heldHead) {
+		uint8_t next = (jobHead + 1) % SPI_JOB_QUEUE;
+		if (next == jobTail)
+			break;
+		jobs[jobHead] = heldJobs[heldTail];
+		jobHead = next;
+		heldTail = (heldTail + 1) % SPI_JOB_QUEUE;
+	}
+	if (!jobActive && jobTail != jobHead)
+		startJob();
+}
+
+// Completes the running job without the DMAC interrupt. Interrupt
+// handlers of the same or a higher priority, and code running with
+// interrupts disabled, would wait for it forever. Called with interrupts
+// disabled.
+void SPIClass::pollJob(void) {
+	if (jobActive && (DMAC->DMAC_CHSR & (DMAC_CHSR_ENA0 << SPI_DMAC_RX_CH)) == 0)
+		onDmacInterrupt();
+}
+
+void SPIClass::flush(void) {
+	// Nothing queued, the common case of every synchronous transfer
+	if (!jobActive)
+		return;
+
+	bool poll = __get_IPSR() != 0 || !interruptsStatus();
+	while (jobActive) {
+		if (!poll)
+			continue;
+		uint8_t irestore = interruptsStatus();
+		noInterrupts();
+		pollJob();
+		if (irestore) interrupts();
+	}
 }
 
 void SPIClass::attachInterrupt(void) {
@@ -38,26 +38,41 @@
 #define SPI_MODE2 0x03
 #define SPI_MODE3 0x01
 
+// Buffer transfers longer than this are moved by the DMA controller
+#ifndef SPI_DMA_THRESHOLD
+#define SPI_DMA_THRESHOLD 32
+#endif
+
+// Number of asynchronous transfers that can be queued per SPIClass
+#ifndef SPI_ASYNC_QUEUE_SIZE
+#define SPI_ASYNC_QUEUE_SIZE 4
+#endif
+
 enum SPITransferMode {
 	SPI_CONTINUE,
 	SPI_LAST
 };
 
+// dataBits selects frames of 8 to 16 bits. With more than 8 bits,
+// transfer16() moves one frame per call and buffered transfer16()/write16()
+// take one uint16_t per frame. The byte buffer transfer(), write() and
+// read() forward to them: the buffer, 2 byte aligned, holds uint16_t
+// frames and _count is its size in bytes (an odd last byte is left out).
 class SPISettings {
 public:
-	SPISettings(uint32_t clock, BitOrder bitOrder, uint8_t dataMode) {
+	SPISettings(uint32_t clock, BitOrder bitOrder, uint8_t dataMode, uint8_t dataBits = 8) {
 		if (__builtin_constant_p(clock)) {
-			init_AlwaysInline(clock, bitOrder, dataMode);
+			init_AlwaysInline(clock, bitOrder, dataMode, dataBits);
 		} else {
-			init_MightInline(clock, bitOrder, dataMode);
+			init_MightInline(clock, bitOrder, dataMode, dataBits);
 		}
 	}
-	SPISettings() { init_AlwaysInline(4000000, MSBFIRST, SPI_MODE0); }
+	SPISettings() { init_AlwaysInline(4000000, MSBFIRST, SPI_MODE0, 8); }
 private:
-	void init_MightInline(uint32_t clock, BitOrder bitOrder, uint8_t dataMode) {
-		init_AlwaysInline(clock, bitOrder, dataMode);
+	void init_MightInline(uint32_t clock, BitOrder bitOrder, uint8_t dataMode, uint8_t dataBits) {
+		init_AlwaysInline(clock, bitOrder, dataMode, dataBits);
 	}
-	void init_AlwaysInline(uint32_t clock, BitOrder bitOrder, uint8_t dataMode) __attribute__((__always_inline__)) {
+	void init_AlwaysInline(uint32_t clock, BitOrder bitOrder, uint8_t dataMode, uint8_t dataBits) __attribute__((__always_inline__)) {
 		border = bitOrder;
 		uint8_t div;
 		if (clock < (F_CPU / 255)) {
@@ -67,11 +82,17 @@ private:
 		} else {
 			div = (F_CPU / (clock + 1)) + 1;
 		}
-		config = (dataMode & 3) | SPI_CSR_CSAAT | SPI_CSR_SCBR(div) | SPI_CSR_DLYBCT(1);
+		if (dataBits < 8) {
+			dataBits = 8;
+		} else if (dataBits > 16) {
+			dataBits = 16;
+		}
+		config = (dataMode & 3) | SPI_CSR_CSAAT | SPI_CSR_SCBR(div) | SPI_CSR_DLYBCT(1) | ((uint32_t)(dataBits - 8) << SPI_CSR_BITS_Pos);
 	}
 	uint32_t config;
 	BitOrder border;
 	friend class SPIClass;
+	friend class USARTSPIClass;
 };
 
 
@@ -84,10 +105,50 @@ class SPIClass {
 	byte transfer(byte _pin, uint8_t _data, SPITransferMode _mode = SPI_LAST);
 	uint16_t transfer16(byte _pin, uint16_t _data, SPITransferMode _mode = SPI_LAST);
 	void transfer(byte _pin, void *_buf, size_t _count, SPITransferMode _mode = SPI_LAST);
+	void transfer16(byte _pin, uint16_t *_buf, size_t _count, SPITransferMode _mode = SPI_LAST);
 	// Transfer functions on default pin BOARD_SPI_DEFAULT_SS
 	byte transfer(uint8_t _data, SPITransferMode _mode = SPI_LAST) { return transfer(BOARD_SPI_DEFAULT_SS, _data, _mode); }
 	uint16_t transfer16(uint16_t _data, SPITransferMode _mode = SPI_LAST) { return transfer16(BOARD_SPI_DEFAULT_SS, _data, _mode); }
 	void transfer(void *_buf, size_t _count, SPITransferMode _mode = SPI_LAST) { transfer(BOARD_SPI_DEFAULT_SS, _buf, _count, _mode); }
+	void transfer16(uint16_t *_buf, size_t _count, SPITransferMode _mode = SPI_LAST) { transfer16(BOARD_SPI_DEFAULT_SS, _buf, _count, _mode); }
+
+	// One way buffer transfers: write() drops the received data and leaves
+	// the buffer untouched, read() sends _fill for every byte it receives
+	void write(byte _pin, const void *_buf, size_t _count, SPITransferMode _mode = SPI_LAST);
+	void write16(byte _pin, const uint16_t *_buf, size_t _count, SPITransferMode _mode = SPI_LAST);
+	void read(byte _pin, void *_buf, size_t _count, uint8_t _fill = 0xFF, SPITransferMode _mode = SPI_LAST);
+	void write(const void *_buf, size_t _count, SPITransferMode _mode = SPI_LAST) { write(BOARD_SPI_DEFAULT_SS, _buf, _count, _mode); }
+	void write16(const uint16_t *_buf, size_t _count, SPITransferMode _mode = SPI_LAST) { write16(BOARD_SPI_DEFAULT_SS, _buf, _count, _mode); }
+	void read(void *_buf, size_t _count, uint8_t _fill = 0xFF, SPITransferMode _mode = SPI_LAST) { read(BOARD_SPI_DEFAULT_SS, _buf, _count, _fill, _mode); }
+
+	// Asynchronous transfers, moved by the DMA controller in the background.
+	// Jobs run one after the other, each with the settings the pin had when
+	// it was queued (or the given SPISettings). The pin gets its own settings
+	// back when the job is done. Once the chip select has been handled
+	// according to _mode, _callback is called from the interrupt.
+	// A NULL _txBuf sends 0xFF, a NULL _rxBuf discards the received data.
+	// With 9 to 16 bit frames the buffers hold uint16_t and _count is the
+	// number of frames.
+	// Returns false if the queue is full, _count is 0 or the pin is set to
+	// LSBFIRST.
+	//
+	// Interrupt handlers may queue transfers without usingInterrupt(): while
+	// a transaction is open their jobs are held back and start as soon as
+	// endTransaction() is called, nothing is masked meanwhile. They should
+	// pass their SPISettings, the pin may be reconfigured by the transaction.
+	// Handlers that use transactions or synchronous transfers instead
+	// (usingInterrupt() libraries) do not wait for the DMAC interrupt, which
+	// could not preempt them: beginTransaction() and flush() complete the
+	// queued jobs right there, running their callbacks in the handler.
+	bool transferAsync(byte _pin, const void *_txBuf, void *_rxBuf, size_t _count, void (*_callback)(void) = NULL, SPITransferMode _mode = SPI_LAST);
+	bool transferAsync(byte _pin, SPISettings settings, const void *_txBuf, void *_rxBuf, size_t _count, void (*_callback)(void) = NULL, SPITransferMode _mode = SPI_LAST);
+	bool isBusy(void) { return jobActive; }
+	// Wait until all queued transfers completed. The synchronous transfers
+	// and the setters call it first. From an interrupt handler, or with
+	// interrupts disabled, the jobs are completed right there (their
+	// callbacks run in that context) instead of waiting for the DMAC
+	// interrupt.
+	void flush(void);
 
 	// Transaction Functions
 	void usingInterrupt(uint8_t interruptNumber);
@@ -116,19 +177,60 @@ class SPIClass {
 	void setDataMode(uint8_t _mode) { setDataMode(BOARD_SPI_DEFAULT_SS, _mode); };
 	void setClockDivider(uint8_t _div) { setClockDivider(BOARD_SPI_DEFAULT_SS, _div); };
 
+	// Called by the DMAC interrupt
+	void onDmacInterrupt(void);
+
   private:
 	void init();
+	uint32_t frameBits(uint32_t _ch) { return 8 + ((csrCache[_ch] & SPI_CSR_BITS_Msk) >> SPI_CSR_BITS_Pos); }
+	// All writes to SPI_CSR go through here, csrCache mirrors the registers
+	void writeCSR(uint32_t _ch, uint32_t _config) { csrCache[_ch] = _config; spi->SPI_CSR[_ch] = _config; }
+	void transferDMA(uint32_t _ch, const void *_txBuf, bool _txIncr, void *_rxBuf, size_t _count, uint32_t _unit);
+	void dmaBegin(uint32_t _ch, uint32_t _config);
+	void dmaEnd(uint32_t _ch, uint32_t _config);
+	void dmaStart(const void *_txBuf, bool _txIncr, void *_rxBuf, bool _rxIncr, size_t _count, uint32_t _unit);
+	bool queueJob(uint32_t _ch, const uint32_t *_config, const void *_txBuf, void *_rxBuf, size_t _count, void (*_callback)(void), SPITransferMode _mode);
+	void startJob(void);
+	void startBlock(void);
+	void releaseHeld(void);
+	void pollJob(void);
+
+	struct Job {
+		const uint8_t *txBuf;
+		uint8_t *rxBuf;
+		size_t count;
+		uint32_t ch;
+		uint32_t config;
+		uint32_t restore;	// SPI_CSR of the pin before the job
+		SPITransferMode mode;
+		void (*callback)(void);
+	};
 
 	Spi *spi;
 	uint32_t id;
 	BitOrder bitOrder[SPI_CHANNELS_NUM];
 	uint32_t divider[SPI_CHANNELS_NUM];
 	uint32_t mode[SPI_CHANNELS_NUM];
+	uint32_t csrCache[SPI_CHANNELS_NUM];
 	void (*initCb)(void);
 	bool initialized;
 	uint8_t interruptMode;    // 0=none, 1-15=mask, 16=global
 	uint8_t interruptSave;    // temp storage, to restore state
 	uint32_t interruptMask[4];
+
+	// The running job stays at jobTail until it completed
+	Job jobs[SPI_ASYNC_QUEUE_SIZE + 1];
+	volatile uint8_t jobHead;
+	volatile uint8_t jobTail;
+	volatile bool jobActive;
+	// Jobs queued from interrupts during a transaction
+	Job heldJobs[SPI_ASYNC_QUEUE_SIZE + 1];
+	volatile uint8_t heldHead;
+	volatile uint8_t heldTail;
+	volatile bool inTransaction;
+	size_t jobDone;
+	size_t jobBlock;
+	uint32_t jobUnit;
 };
 
 #if SPI_INTERFACES_COUNT > 0
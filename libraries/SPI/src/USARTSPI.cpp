@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * SPI Master on the USART controllers for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#include "USARTSPI.h"
+
+// In SPI master mode SCK is MCK / CD, CD must be at least 6
+#define USARTSPI_MIN_DIVIDER	6
+// Largest transfer of the PDC counter registers
+#define USARTSPI_PDC_MAX_BLOCK	65535
+
+// The USART shifts MSB first in SPI mode (the MSBF bit is CPOL there),
+// LSBFIRST bytes are reversed in software.
+template <BitOrder order>
+static inline uint32_t USARTSPI_Reverse(uint32_t d) {
+	return (order == LSBFIRST) ? __RBIT(d) >> 24 : d;
+}
+
+// Polled buffer transfer, see SPI_TransferBuffer() in SPI.cpp
+template <BitOrder order>
+static void USARTSPI_TransferBuffer(Usart *usart, const uint8_t *tx, size_t txStep, uint8_t *rx, size_t count) {
+	if (!rx) {
+		for (; count > 0; count--, tx += txStep) {
+			while ((usart->US_CSR & US_CSR_TXRDY) == 0)
+				;
+			usart->US_THR = USARTSPI_Reverse<order>(*tx);
+		}
+
+		// Wait for the last byte, then drop the received data and the
+		// overrun flag
+		while ((usart->US_CSR & US_CSR_TXEMPTY) == 0)
+			;
+		usart->US_RHR;
+		usart->US_CR = US_CR_RSTSTA;
+		return;
+	}
+
+	// Send the first byte
+	while ((usart->US_CSR & US_CSR_TXRDY) == 0)
+		;
+	usart->US_THR = USARTSPI_Reverse<order>(*tx);
+	tx += txStep;
+
+	while (count > 1) {
+		// Prepare next byte
+		uint32_t d = USARTSPI_Reverse<order>(*tx);
+		tx += txStep;
+
+		// Read transferred byte and send next one straight away
+		while ((usart->US_CSR & US_CSR_RXRDY) == 0)
+			;
+		uint32_t r = usart->US_RHR & 0xFF;
+		usart->US_THR = d;
+
+		// Save read byte
+		*rx++ = USARTSPI_Reverse<order>(r);
+		count--;
+	}
+
+	// Receive the last transferred byte
+	while ((usart->US_CSR & US_CSR_RXRDY) == 0)
+		;
+	*rx = USARTSPI_Reverse<order>(usart->US_RHR & 0xFF);
+}
+
+static void USARTSPI_TransferBuffer(Usart *usart, BitOrder order, const uint8_t *tx, size_t txStep, uint8_t *rx, size_t count) {
+	if (order == LSBFIRST)
+		USARTSPI_TransferBuffer<LSBFIRST>(usart, tx, txStep, rx, count);
+	else
+		USARTSPI_TransferBuffer<MSBFIRST>(usart, tx, txStep, rx, count);
+}
+
+USARTSPIClass::USARTSPIClass(Usart *_usart, uint32_t _id, void(*_initCb)(void)) :
+	usart(_usart), id(_id), bitOrder(MSBFIRST), mode(SPI_MODE0), divider(21),
+	initCb(_initCb), initialized(false)
+{
+	// Empty
+}
+
+void USARTSPIClass::begin() {
+	if (initialized)
+		return;
+	initCb();
+	pmc_enable_periph_clk(id);
+
+	usart->US_PTCR = US_PTCR_RXTDIS | US_PTCR_TXTDIS;
+	usart->US_CR = US_CR_RSTRX | US_CR_RSTTX | US_CR_RXDIS | US_CR_TXDIS | US_CR_RSTSTA;
+	usart->US_IDR = 0xFFFFFFFF;
+
+	// Default speed set to 4Mhz
+	bitOrder = MSBFIRST;
+	configure(SPI_MODE0, 21);
+	usart->US_CR = US_CR_RXEN | US_CR_TXEN;
+	initialized = true;
+}
+
+void USARTSPIClass::end() {
+	usart->US_CR = US_CR_RXDIS | US_CR_TXDIS;
+	pmc_disable_periph_clk(id);
+	initialized = false;
+}
+
+void USARTSPIClass::beginTransaction(SPISettings settings) {
+	bitOrder = settings.border;
+	configure(settings.config & (SPI_CSR_CPOL | SPI_CSR_NCPHA),
+			(settings.config & SPI_CSR_SCBR_Msk) >> SPI_CSR_SCBR_Pos);
+}
+
+void USARTSPIClass::setDataMode(uint8_t _mode) {
+	configure(_mode, divider);
+}
+
+void USARTSPIClass::setClockDivider(uint8_t _divider) {
+	configure(mode, _divider);
+}
+
+// _mode is one of SPI_MODE0..3, that is the CPOL and NCPHA bits of the SPI
+// controller. NCPHA matches CPHA of the USART.
+void USARTSPIClass::configure(uint32_t _mode, uint32_t _divider) {
+	if (_divider < USARTSPI_MIN_DIVIDER)
+		_divider = USARTSPI_MIN_DIVIDER;
+
+	// Most transactions reuse the settings of the previous one
+	if (initialized && _mode == mode && _divider == divider)
+		return;
+	mode = _mode;
+	divider = _divider;
+
+	// The clock must not change while a byte is shifted out
+	if (initialized) {
+		while ((usart->US_CSR & US_CSR_TXEMPTY) == 0)
+			;
+	}
+	usart->US_MR = US_MR_USART_MODE_SPI_MASTER | US_MR_USCLKS_MCK | US_MR_CHRL_8_BIT | US_MR_CLKO |
+			((mode & SPI_CSR_CPOL) ? US_MR_CPOL : 0) |
+			((mode & SPI_CSR_NCPHA) ? US_MR_CPHA : 0);
+	usart->US_BRGR = divider;
+}
+
+byte USARTSPIClass::transfer(uint8_t _data) {
+	if (bitOrder == LSBFIRST)
+		_data = USARTSPI_Reverse<LSBFIRST>(_data);
+
+	while ((usart->US_CSR & US_CSR_TXRDY) == 0)
+		;
+	usart->US_THR = _data;
+
+	while ((usart->US_CSR & US_CSR_RXRDY) == 0)
+		;
+	uint32_t r = usart->US_RHR & 0xFF;
+
+	if (bitOrder == LSBFIRST)
+		r = USARTSPI_Reverse<LSBFIRST>(r);
+	return r;
+}
+
+uint16_t USARTSPIClass::transfer16(uint16_t _data) {
+	union { uint16_t val; struct { uint8_t lsb; uint8_t msb; }; } t;
+
+	t.val = _data;
+
+	if (bitOrder == LSBFIRST) {
+		t.lsb = transfer(t.lsb);
+		t.msb = transfer(t.msb);
+	} else {
+		t.msb = transfer(t.msb);
+		t.lsb = transfer(t.lsb);
+	}
+
+	return t.val;
+}
+
+void USARTSPIClass::transfer(void *_buf, size_t _count) {
+	if (_count == 0)
+		return;
+
+	uint8_t *buffer = (uint8_t *)_buf;
+	if (bitOrder != LSBFIRST && _count > SPI_DMA_THRESHOLD)
+		transferPDC(buffer, buffer, _count);
+	else
+		USARTSPI_TransferBuffer(usart, bitOrder, buffer, 1, buffer, _count);
+}
+
+void USARTSPIClass::write(const void *_buf, size_t _count) {
+	if (_count == 0)
+		return;
+
+	const uint8_t *buffer = (const uint8_t *)_buf;
+	if (bitOrder != LSBFIRST && _count > SPI_DMA_THRESHOLD)
+		transferPDC(buffer, NULL, _count);
+	else
+		USARTSPI_TransferBuffer(usart, bitOrder, buffer, 1, NULL, _count);
+}
+
+void USARTSPIClass::read(void *_buf, size_t _count, uint8_t _fill) {
+	if (_count == 0)
+		return;
+
+	uint8_t *buffer = (uint8_t *)_buf;
+	if (bitOrder != LSBFIRST && _count > SPI_DMA_THRESHOLD) {
+		// The PDC has no fixed address mode. The buffer is filled with
+		// _fill and sent: a byte is received only after it went out, so
+		// the receiver never overwrites a byte that is still to be sent.
+		memset(buffer, _fill, _count);
+		transferPDC(buffer, buffer, _count);
+	} else {
+		USARTSPI_TransferBuffer(usart, bitOrder, &_fill, 0, buffer, _count);
+	}
+}
+
+// Without a receive buffer only the transmitter is served, the received
+// data is dropped at the end. _txBuf and _rxBuf may be the same buffer.
+void USARTSPIClass::transferPDC(const uint8_t *_txBuf, uint8_t *_rxBuf, size_t _count) {
+	// Drop stale data
+	if (usart->US_CSR & US_CSR_RXRDY)
+		usart->US_RHR;
+	usart->US_CR = US_CR_RSTSTA;
+
+	while (_count > 0) {
+		uint32_t n = min(_count, (size_t)USARTSPI_PDC_MAX_BLOCK);
+		if (_rxBuf) {
+			// RX is set up first, it must be ready for the first byte
+			usart->US_RPR = (uint32_t)_rxBuf;
+			usart->US_RCR = n;
+			usart->US_TPR = (uint32_t)_txBuf;
+			usart->US_TCR = n;
+			usart->US_PTCR = US_PTCR_RXTEN | US_PTCR_TXTEN;
+			while ((usart->US_CSR & US_CSR_ENDRX) == 0)
+				;
+			_rxBuf += n;
+		} else {
+			usart->US_TPR = (uint32_t)_txBuf;
+			usart->US_TCR = n;
+			usart->US_PTCR = US_PTCR_TXTEN;
+			while ((usart->US_CSR & US_CSR_ENDTX) == 0)
+				;
+		}
+		_txBuf += n;
+		_count -= n;
+	}
+	usart->US_PTCR = US_PTCR_RXTDIS | US_PTCR_TXTDIS;
+
+	if (!_rxBuf) {
+		while ((usart->US_CSR & US_CSR_TXEMPTY) == 0)
+			;
+		usart->US_RHR;
+		usart->US_CR = US_CR_RSTSTA;
+	}
+}
+
+static void USARTSPI_1_Init(void) {
+	PIO_Configure(PIOA, PIO_PERIPH_A, PIO_PA11A_TXD0 | PIO_PA10A_RXD0, PIO_DEFAULT);
+	PIO_Configure(PIOA, PIO_PERIPH_B, PIO_PA17B_SCK0, PIO_DEFAULT);
+}
+
+static void USARTSPI_2_Init(void) {
+	PIO_Configure(PIOA, PIO_PERIPH_A, PIO_PA13A_TXD1 | PIO_PA12A_RXD1 | PIO_PA16A_SCK1, PIO_DEFAULT);
+}
+
+USARTSPIClass USARTSPI1(USART0, ID_USART0, USARTSPI_1_Init);
+USARTSPIClass USARTSPI2(USART1, ID_USART1, USARTSPI_2_Init);
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * SPI Master on the USART controllers for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _USARTSPI_H_INCLUDED
+#define _USARTSPI_H_INCLUDED
+
+#include "SPI.h"
+
+// SPI master on a USART in SPI mode, a bus of its own next to SPI. It has
+// the AVR style API without chip select handling: the chip select is any
+// digital pin driven by the sketch. Frames are 8 bits, LSBFIRST is done
+// in software. Buffers longer than SPI_DMA_THRESHOLD are moved by the PDC.
+//
+// The USART is taken from its Serial port, the two can not be used at the
+// same time.
+class USARTSPIClass {
+  public:
+	USARTSPIClass(Usart *_usart, uint32_t _id, void(*_initCb)(void));
+
+	// Transfer functions
+	byte transfer(uint8_t _data);
+	uint16_t transfer16(uint16_t _data);
+	void transfer(void *_buf, size_t _count);
+
+	// One way buffer transfers: write() drops the received data and leaves
+	// the buffer untouched, read() sends _fill for every byte it receives
+	void write(const void *_buf, size_t _count);
+	void read(void *_buf, size_t _count, uint8_t _fill = 0xFF);
+
+	// Transaction Functions
+	void beginTransaction(SPISettings settings);
+	void endTransaction(void) { }
+
+	void begin(void);
+	void end(void);
+
+	void setBitOrder(BitOrder _order) { bitOrder = _order; }
+	void setDataMode(uint8_t _mode);
+	void setClockDivider(uint8_t _div);
+
+  private:
+	void configure(uint32_t _mode, uint32_t _divider);
+	void transferPDC(const uint8_t *_txBuf, uint8_t *_rxBuf, size_t _count);
+
+	Usart *usart;
+	uint32_t id;
+	BitOrder bitOrder;
+	uint32_t mode;
+	uint32_t divider;
+	void (*initCb)(void);
+	bool initialized;
+};
+
+// USART0, taken from Serial1: MOSI TX1 (18), MISO RX1 (19), SCK SDA1 (70)
+extern USARTSPIClass USARTSPI1;
+// USART1, taken from Serial2: MOSI TX2 (16), MISO RX2 (17), SCK A0 (54)
+extern USARTSPIClass USARTSPI2;
+
+#endif
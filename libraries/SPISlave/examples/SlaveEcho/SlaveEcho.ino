@@ -0,0 +1,49 @@
+/*
+  SPI Slave Echo
+
+  The Due acts as an SPI slave. Every frame sent by the master (slave
+  select low to high) is printed on the serial monitor, and the next frame
+  returns the data of the previous one to the master.
+
+  The circuit:
+  * SS   - the master's chip select to digital pin 10
+  * MOSI - ICSP header pin 4
+  * MISO - ICSP header pin 1
+  * SCK  - ICSP header pin 3
+  * GND  - connected between both boards
+
+  This example code is in the public domain.
+*/
+
+#include <SPI.h>
+#include <SPISlave.h>
+
+uint8_t frame[256];
+// Two replies, one may still be sent while the other is filled
+uint8_t reply[2][256];
+int current = 0;
+
+void setup() {
+  Serial.begin(115200);
+  SPISlave.begin(SPI_MODE0);
+}
+
+void loop() {
+  int len = SPISlave.readFrame(frame, sizeof(frame));
+  if (len < 0)
+    return;
+
+  // Answer with this frame from the next one on
+  current = 1 - current;
+  memcpy(reply[current], frame, len);
+  SPISlave.setResponse(reply[current], len);
+
+  Serial.print("Received ");
+  Serial.print(len);
+  Serial.print(" bytes:");
+  for (int i = 0; i < len; i++) {
+    Serial.print(' ');
+    Serial.print(frame[i], HEX);
+  }
+  Serial.println();
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * SPI Slave library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#include "SPISlave.h"
+
+// DMA controller channels, apart from the ones of SPIClass, and the SPI0
+// hardware handshaking interfaces. RX gets the higher priority.
+#define SPI_SLAVE_TX_CH		2
+#define SPI_SLAVE_RX_CH		3
+#define SPI_SLAVE_TX_PER	1
+#define SPI_SLAVE_RX_PER	2
+// Largest block the DMAC moves with one descriptor (BTSIZE)
+#define SPI_SLAVE_MAX_BLOCK	4095
+
+#define SPI_SLAVE_HALF		(SPI_SLAVE_BUFFER_SIZE / 2)
+
+static_assert((SPI_SLAVE_BUFFER_SIZE % 2) == 0 && SPI_SLAVE_BUFFER_SIZE >= 2,
+		"SPI_SLAVE_BUFFER_SIZE must be even and at least 2, it is used as two halves");
+
+// Sent once the response is exhausted. In SRAM, the DMAC reads it.
+static uint8_t slaveFill = 0xFF;
+
+SPISlaveClass::SPISlaveClass(Spi *_spi, uint32_t _id, void(*_initCb)(void)) :
+	spi(_spi), id(_id), initCb(_initCb), csr(0), active(false),
+	response(NULL), responseLen(0), rxTail(0), frameStart(0),
+	frameHead(0), frameTail(0), callback(NULL)
+{
+	// Empty
+}
+
+void SPISlaveClass::begin(uint8_t _mode) {
+	if (active)
+		end();
+
+	initCb();
+	pmc_enable_periph_clk(id);
+	pmc_enable_periph_clk(ID_DMAC);
+	DMAC->DMAC_GCFG = DMAC_GCFG_ARB_CFG_FIXED;
+	DMAC->DMAC_EN = DMAC_EN_ENABLE;
+
+	csr = _mode & 3;
+	rxTail = 0;
+	frameStart = 0;
+	frameHead = 0;
+	frameTail = 0;
+
+	// The receive channel runs forever around the ring, each half of it
+	// is one linked list item pointing to the other
+	for (int i = 0; i < 2; i++) {
+		rxDesc[i].saddr = (uint32_t)&spi->SPI_RDR;
+		rxDesc[i].daddr = (uint32_t)&buffer[i * SPI_SLAVE_HALF];
+		rxDesc[i].ctrla = SPI_SLAVE_HALF | DMAC_CTRLA_SRC_WIDTH_BYTE | DMAC_CTRLA_DST_WIDTH_BYTE;
+		rxDesc[i].ctrlb = DMAC_CTRLB_SRC_DSCR_FETCH_DISABLE | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM |
+				DMAC_CTRLB_FC_PER2MEM_DMA_FC | DMAC_CTRLB_SRC_INCR_FIXED | DMAC_CTRLB_DST_INCR_INCREMENTING;
+		rxDesc[i].dscr = (uint32_t)&rxDesc[1 - i];
+	}
+
+	DmacCh_num *rx = &DMAC->DMAC_CH_NUM[SPI_SLAVE_RX_CH];
+	rx->DMAC_SADDR = (uint32_t)&spi->SPI_RDR;
+	rx->DMAC_DSCR = (uint32_t)&rxDesc[0];
+	rx->DMAC_CTRLB = rxDesc[0].ctrlb;
+	rx->DMAC_CFG = DMAC_CFG_SRC_PER(SPI_SLAVE_RX_PER) | DMAC_CFG_SRC_H2SEL_HW |
+			DMAC_CFG_SOD_DISABLE | DMAC_CFG_FIFOCFG_ASAP_CFG;
+	DMAC->DMAC_CHER = DMAC_CHER_ENA0 << SPI_SLAVE_RX_CH;
+
+	startResponse();
+
+	NVIC_ClearPendingIRQ((IRQn_Type)id);
+	NVIC_EnableIRQ((IRQn_Type)id);
+	active = true;
+}
+
+void SPISlaveClass::end(void) {
+	spi->SPI_IDR = SPI_IDR_NSSR;
+	NVIC_DisableIRQ((IRQn_Type)id);
+	DMAC->DMAC_CHDR = (DMAC_CHDR_DIS0 << SPI_SLAVE_TX_CH) | (DMAC_CHDR_DIS0 << SPI_SLAVE_RX_CH);
+	spi->SPI_CR = SPI_CR_SPIDIS;
+	active = false;
+}
+
+void SPISlaveClass::setResponse(const void *_buf, size_t _count) {
+	uint8_t irestore = !__get_PRIMASK();
+	noInterrupts();
+	response = (const uint8_t *)_buf;
+	responseLen = min(_count, (size_t)SPI_SLAVE_MAX_BLOCK);
+
+	// Between frames the new response is loaded right away, otherwise
+	// it starts with the next one
+	const PinDescription &nss = g_APinDescription[PIN_SPI_SS0];
+	if (active && (nss.pPort->PIO_PDSR & nss.ulPin))
+		startResponse();
+	if (irestore) interrupts();
+}
+
+// TDR and the shift register already hold the next bytes of the previous
+// response, only a reset of the controller drops them
+void SPISlaveClass::startResponse(void) {
+	DMAC->DMAC_CHDR = DMAC_CHDR_DIS0 << SPI_SLAVE_TX_CH;
+	while (DMAC->DMAC_CHSR & (DMAC_CHSR_ENA0 << SPI_SLAVE_TX_CH))
+		;
+
+	spi->SPI_CR = SPI_CR_SWRST;
+	spi->SPI_MR = SPI_MR_MODFDIS;
+	spi->SPI_CSR[0] = csr;
+	spi->SPI_IER = SPI_IER_NSSR;
+	spi->SPI_CR = SPI_CR_SPIEN;
+
+	// The response, then 0xFF for as long as the master keeps clocking
+	txDesc[0].saddr = (uint32_t)response;
+	txDesc[0].daddr = (uint32_t)&spi->SPI_TDR;
+	txDesc[0].ctrla = responseLen | DMAC_CTRLA_SRC_WIDTH_BYTE | DMAC_CTRLA_DST_WIDTH_BYTE;
+	txDesc[0].ctrlb = DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM | DMAC_CTRLB_DST_DSCR_FETCH_DISABLE |
+			DMAC_CTRLB_FC_MEM2PER_DMA_FC | DMAC_CTRLB_SRC_INCR_INCREMENTING | DMAC_CTRLB_DST_INCR_FIXED;
+	txDesc[0].dscr = (uint32_t)&txDesc[1];
+	txDesc[1].saddr = (uint32_t)&slaveFill;
+	txDesc[1].daddr = (uint32_t)&spi->SPI_TDR;
+	txDesc[1].ctrla = SPI_SLAVE_MAX_BLOCK | DMAC_CTRLA_SRC_WIDTH_BYTE | DMAC_CTRLA_DST_WIDTH_BYTE;
+	txDesc[1].ctrlb = DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM | DMAC_CTRLB_DST_DSCR_FETCH_DISABLE |
+			DMAC_CTRLB_FC_MEM2PER_DMA_FC | DMAC_CTRLB_SRC_INCR_FIXED | DMAC_CTRLB_DST_INCR_FIXED;
+	txDesc[1].dscr = (uint32_t)&txDesc[1];
+
+	DmacCh_num *tx = &DMAC->DMAC_CH_NUM[SPI_SLAVE_TX_CH];
+	tx->DMAC_DADDR = (uint32_t)&spi->SPI_TDR;
+	tx->DMAC_DSCR = (uint32_t)(responseLen ? &txDesc[0] : &txDesc[1]);
+	tx->DMAC_CTRLB = txDesc[0].ctrlb;
+	tx->DMAC_CFG = DMAC_CFG_DST_PER(SPI_SLAVE_TX_PER) | DMAC_CFG_DST_H2SEL_HW |
+			DMAC_CFG_SOD_DISABLE | DMAC_CFG_FIFOCFG_ALAP_CFG;
+	DMAC->DMAC_CHER = DMAC_CHER_ENA0 << SPI_SLAVE_TX_CH;
+}
+
+// Bytes received since begin(), from the position of the receive channel
+// in the ring
+uint32_t SPISlaveClass::received(void) {
+	uint32_t index = DMAC->DMAC_CH_NUM[SPI_SLAVE_RX_CH].DMAC_DADDR - (uint32_t)buffer;
+	if (index >= SPI_SLAVE_BUFFER_SIZE)
+		index = 0;
+	uint32_t tail = rxTail;
+	return tail + (index + SPI_SLAVE_BUFFER_SIZE - tail % SPI_SLAVE_BUFFER_SIZE) % SPI_SLAVE_BUFFER_SIZE;
+}
+
+int SPISlaveClass::available(void) {
+	return received() - rxTail;
+}
+
+int SPISlaveClass::read(void) {
+	if (available() == 0)
+		return -1;
+	uint8_t c = buffer[rxTail % SPI_SLAVE_BUFFER_SIZE];
+	rxTail = rxTail + 1;
+	return c;
+}
+
+size_t SPISlaveClass::read(void *_buf, size_t _count) {
+	uint8_t *dst = (uint8_t *)_buf;
+	size_t n = min(_count, (size_t)available());
+	uint32_t tail = rxTail;
+	for (size_t i = 0; i < n; i++)
+		*dst++ = buffer[tail++ % SPI_SLAVE_BUFFER_SIZE];
+	rxTail = tail;
+	return n;
+}
+
+int SPISlaveClass::frames(void) {
+	return (SPI_SLAVE_FRAMES + frameHead - frameTail) % SPI_SLAVE_FRAMES;
+}
+
+int SPISlaveClass::readFrame(void *_buf, size_t _count) {
+	if (frameHead == frameTail)
+		return -1;
+	uint32_t end = frameEnd[frameTail];
+	frameTail = (frameTail + 1) % SPI_SLAVE_FRAMES;
+
+	// Bytes of the frame taken by read() already are not returned again
+	int32_t len = end - rxTail;
+	if (len <= 0)
+		return 0;
+
+	uint8_t *dst = (uint8_t *)_buf;
+	size_t n = min(_count, (size_t)len);
+	uint32_t tail = rxTail;
+	for (size_t i = 0; i < n; i++)
+		*dst++ = buffer[tail++ % SPI_SLAVE_BUFFER_SIZE];
+	rxTail = end;
+	return n;
+}
+
+void SPISlaveClass::onReceive(void (*_callback)(size_t)) {
+	callback = _callback;
+}
+
+void SPISlaveClass::onNSSInterrupt(void) {
+	if ((spi->SPI_SR & SPI_SR_NSSR) == 0)
+		return;
+
+	// The receive channel still has to fetch the last byte
+	while (spi->SPI_SR & SPI_SR_RDRF)
+		;
+
+	uint32_t end = received();
+	uint8_t next = (frameHead + 1) % SPI_SLAVE_FRAMES;
+	if (next != frameTail) {
+		frameEnd[frameHead] = end;
+		frameHead = next;
+	}
+	size_t len = end - frameStart;
+	frameStart = end;
+
+	startResponse();
+
+	if (callback)
+		callback(len);
+}
+
+#if SPI_INTERFACES_COUNT > 0
+static void SPISlave_0_Init(void) {
+	PIO_Configure(
+			g_APinDescription[PIN_SPI_MOSI].pPort,
+			g_APinDescription[PIN_SPI_MOSI].ulPinType,
+			g_APinDescription[PIN_SPI_MOSI].ulPin,
+			g_APinDescription[PIN_SPI_MOSI].ulPinConfiguration);
+	PIO_Configure(
+			g_APinDescription[PIN_SPI_MISO].pPort,
+			g_APinDescription[PIN_SPI_MISO].ulPinType,
+			g_APinDescription[PIN_SPI_MISO].ulPin,
+			g_APinDescription[PIN_SPI_MISO].ulPinConfiguration);
+	PIO_Configure(
+			g_APinDescription[PIN_SPI_SCK].pPort,
+			g_APinDescription[PIN_SPI_SCK].ulPinType,
+			g_APinDescription[PIN_SPI_SCK].ulPin,
+			g_APinDescription[PIN_SPI_SCK].ulPinConfiguration);
+	PIO_Configure(
+			g_APinDescription[PIN_SPI_SS0].pPort,
+			g_APinDescription[PIN_SPI_SS0].ulPinType,
+			g_APinDescription[PIN_SPI_SS0].ulPin,
+			g_APinDescription[PIN_SPI_SS0].ulPinConfiguration);
+}
+
+SPISlaveClass SPISlave(SPI_INTERFACE, SPI_INTERFACE_ID, SPISlave_0_Init);
+
+void SPI0_Handler(void) {
+	SPISlave.onNSSInterrupt();
+}
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015 by Arduino LLC
+ * SPI Slave library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _SPI_SLAVE_H_INCLUDED
+#define _SPI_SLAVE_H_INCLUDED
+
+#include <SPI.h>
+
+// Size of the receive ring, must be even. Data that is not read in time
+// is overwritten.
+#ifndef SPI_SLAVE_BUFFER_SIZE
+#define SPI_SLAVE_BUFFER_SIZE 1024
+#endif
+
+// Number of received frames remembered until they are read
+#ifndef SPI_SLAVE_FRAMES
+#define SPI_SLAVE_FRAMES 16
+#endif
+
+// Linked list item of the DMA controller
+typedef struct {
+	uint32_t saddr;
+	uint32_t daddr;
+	uint32_t ctrla;
+	uint32_t ctrlb;
+	uint32_t dscr;
+} SPIDmacDescriptor;
+
+// The SPI controller as a slave on the SPI header, selected by NSS on
+// pin 10. Received bytes are written to a ring by the DMA controller; a
+// frame ends when NSS goes high. The response is sent from the start of
+// each frame, so the master should leave a few microseconds between
+// frames for the interrupt to reload it.
+class SPISlaveClass {
+  public:
+	SPISlaveClass(Spi *_spi, uint32_t _id, void(*_initCb)(void));
+
+	// _mode is one of SPI_MODE0 to SPI_MODE3, frames are 8 bit
+	void begin(uint8_t _mode = SPI_MODE0);
+	void end(void);
+
+	// Data sent to the master from the start of every frame, 0xFF follows
+	// once it is exhausted. The buffer is not copied and must stay valid.
+	void setResponse(const void *_buf, size_t _count);
+
+	// Received bytes, regardless of frames
+	int available(void);
+	int read(void);
+	size_t read(void *_buf, size_t _count);
+
+	// Number of complete frames not read yet
+	int frames(void);
+	// Reads the rest of the next frame, bytes that do not fit in _buf are
+	// dropped. Returns the number of bytes stored or -1 without frame.
+	int readFrame(void *_buf, size_t _count);
+
+	// Called from the interrupt at the end of each frame with its length
+	void onReceive(void (*_callback)(size_t));
+
+	// Called by the SPI interrupt
+	void onNSSInterrupt(void);
+
+  private:
+	uint32_t received(void);
+	void startResponse(void);
+
+	Spi *spi;
+	uint32_t id;
+	void (*initCb)(void);
+	uint32_t csr;
+	bool active;
+
+	uint8_t buffer[SPI_SLAVE_BUFFER_SIZE];
+	SPIDmacDescriptor rxDesc[2];
+	SPIDmacDescriptor txDesc[2];
+	const uint8_t *response;
+	size_t responseLen;
+
+	// Byte counters since begin(), the ring position is their remainder
+	volatile uint32_t rxTail;
+	uint32_t frameStart;
+	volatile uint32_t frameEnd[SPI_SLAVE_FRAMES];
+	volatile uint8_t frameHead;
+	volatile uint8_t frameTail;
+
+	void (*callback)(size_t);
+};
+
+#if SPI_INTERFACES_COUNT > 0
+extern SPISlaveClass SPISlave;
+#endif
+
+#endif
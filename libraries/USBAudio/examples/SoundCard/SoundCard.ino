@@ -0,0 +1,23 @@
+// USB sound card
+//
+// Plug the Native USB port into a computer: the Due shows up as a
+// USB Audio Class 2.0 device without any driver. Audio played on it
+// comes out of DAC0 (left) and DAC1 (right), audio recorded from it
+// is sampled on A0.
+
+// This example code is in the public domain.
+
+
+#include <USBAudio.h>
+
+void setup()
+{
+  USBAudio.begin(A0);          // start the converters, A0 is the microphone
+  pinMode(LED_BUILTIN, OUTPUT);
+}
+
+void loop()
+{
+  // light the LED while the host is playing or recording
+  digitalWrite(LED_BUILTIN, USBAudio.speakerActive() || USBAudio.micActive());
+}
@@ -0,0 +1,455 @@
+/* Copyright (c) 2015, Arduino LLC
+**
+** Permission to use, copy, modify, and/or distribute this software for
+** any purpose with or without fee is hereby granted, provided that the
+** above copyright notice and this permission notice appear in all copies.
+**
+** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+** WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+** BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+** OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+** WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+** ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+** SOFTWARE.
+*/
+
+#include "USBAudio.h"
+
+#if defined(USBCON)
+
+// Endpoints are sized for one 1ms packet on two banks, so that the three
+// of them fit in DPRAM next to the CDC endpoints
+#define EP_TYPE_AUDIO_OUT		(UOTGHS_DEVEPTCFG_EPSIZE_256_BYTE | \
+								UOTGHS_DEVEPTCFG_EPTYPE_ISO |        \
+								UOTGHS_DEVEPTCFG_EPBK_2_BANK |       \
+								UOTGHS_DEVEPTCFG_NBTRANS_1_TRANS |   \
+								UOTGHS_DEVEPTCFG_ALLOC)
+
+#define EP_TYPE_AUDIO_IN		(UOTGHS_DEVEPTCFG_EPSIZE_128_BYTE | \
+								UOTGHS_DEVEPTCFG_EPDIR_IN |          \
+								UOTGHS_DEVEPTCFG_EPTYPE_ISO |        \
+								UOTGHS_DEVEPTCFG_EPBK_2_BANK |       \
+								UOTGHS_DEVEPTCFG_NBTRANS_1_TRANS |   \
+								UOTGHS_DEVEPTCFG_ALLOC)
+
+#define EP_TYPE_AUDIO_FEEDBACK	(UOTGHS_DEVEPTCFG_EPSIZE_8_BYTE |   \
+								UOTGHS_DEVEPTCFG_EPDIR_IN |          \
+								UOTGHS_DEVEPTCFG_EPTYPE_ISO |        \
+								UOTGHS_DEVEPTCFG_EPBK_2_BANK |       \
+								UOTGHS_DEVEPTCFG_NBTRANS_1_TRANS |   \
+								UOTGHS_DEVEPTCFG_ALLOC)
+
+#define AUDIO_SPEAKER_EP		(pluggedEndpoint)
+#define AUDIO_FEEDBACK_EP		(pluggedEndpoint+1)
+#define AUDIO_MIC_EP			(pluggedEndpoint+2)
+
+#define AUDIO_SPEAKER_INTERFACE	(pluggedInterface+1)
+#define AUDIO_MIC_INTERFACE		(pluggedInterface+2)
+
+// The PDC moves fixed size blocks between the rings and the converters.
+// Sizes are in half-words and must be powers of two.
+#define DAC_RING_SIZE			1024
+#define DAC_BLOCK_SIZE			64
+#define ADC_RING_SIZE			512
+#define ADC_BLOCK_SIZE			32
+
+// Channel selection bits of DACC_CDR in tag mode
+#define DACC_CDR_TAG_CH1		(1 << 12)
+
+// Stereo samples interleaved and tagged with their DACC channel
+static uint16_t dacRing[DAC_RING_SIZE] __attribute__((aligned(4)));
+static uint16_t dacSilence[DAC_BLOCK_SIZE] __attribute__((aligned(4)));
+static volatile uint32_t dacHead;	// written from the USB interrupt
+static volatile uint32_t dacTail;	// handed to the PDC from the DACC interrupt
+
+static uint16_t adcRing[ADC_RING_SIZE] __attribute__((aligned(4)));
+static volatile uint32_t adcHead;	// completed by the PDC
+static volatile uint32_t adcNext;	// next block given to the PDC
+static uint32_t adcTail;			// sent to the host
+static uint16_t adcLast = 0x800;
+
+USBAudio_ USBAudio;
+
+USBAudio_::USBAudio_(void) : PluggableUSBModule(3, 3, epType),
+                             rate(USBAUDIO_SAMPLE_RATE), micChannel(0), micRemainder(0),
+                             started(false), speakerAlt(0), micAlt(0)
+{
+	epType[0] = EP_TYPE_AUDIO_OUT;
+	epType[1] = EP_TYPE_AUDIO_FEEDBACK;
+	epType[2] = EP_TYPE_AUDIO_IN;
+	PluggableUSB().plug(this);
+}
+
+int USBAudio_::getInterface(uint8_t* interfaceCount)
+{
+	*interfaceCount += 3; // uses 3
+
+	// One packet per millisecond at both speeds
+	const uint8_t interval = USBD_IsHighSpeed() ? 0x04 : 0x01;
+	const uint16_t controlLength = sizeof(AudioACHeaderDescriptor) + sizeof(AudioClockSourceDescriptor) +
+		2 * sizeof(AudioInputTerminalDescriptor) + 2 * sizeof(AudioOutputTerminalDescriptor);
+
+	AudioDescriptor audioInterface = {
+		D_IAD(pluggedInterface, 3, AUDIO_FUNCTION_CLASS, 0, AUDIO_FUNCTION_PROTOCOL_IP_2_0),
+
+		D_INTERFACE(pluggedInterface, 0, AUDIO_FUNCTION_CLASS, AUDIO_SUBCLASS_AUDIOCONTROL, AUDIO_FUNCTION_PROTOCOL_IP_2_0),
+		D_AUDIO_AC_HEADER(AUDIO_CATEGORY_IO_BOX, controlLength),
+		D_AUDIO_CLOCK_SOURCE(AUDIO_CLOCK_ID, 0x01, 0x05), // internal fixed, frequency and validity readable
+		D_AUDIO_INPUT_TERMINAL(AUDIO_SPEAKER_IT_ID, AUDIO_TERMINAL_USB_STREAMING, AUDIO_CLOCK_ID, AUDIO_SPEAKER_CHANNELS, 0x00000003),
+		D_AUDIO_OUTPUT_TERMINAL(AUDIO_SPEAKER_OT_ID, AUDIO_TERMINAL_SPEAKER, AUDIO_SPEAKER_IT_ID, AUDIO_CLOCK_ID),
+		D_AUDIO_INPUT_TERMINAL(AUDIO_MIC_IT_ID, AUDIO_TERMINAL_MICROPHONE, AUDIO_CLOCK_ID, AUDIO_MIC_CHANNELS, 0x00000004),
+		D_AUDIO_OUTPUT_TERMINAL(AUDIO_MIC_OT_ID, AUDIO_TERMINAL_USB_STREAMING, AUDIO_MIC_IT_ID, AUDIO_CLOCK_ID),
+
+		{
+			D_INTERFACE_ALT(AUDIO_SPEAKER_INTERFACE, 0, 0, AUDIO_FUNCTION_CLASS, AUDIO_SUBCLASS_AUDIOSTREAMING, AUDIO_FUNCTION_PROTOCOL_IP_2_0),
+			D_INTERFACE_ALT(AUDIO_SPEAKER_INTERFACE, 1, 2, AUDIO_FUNCTION_CLASS, AUDIO_SUBCLASS_AUDIOSTREAMING, AUDIO_FUNCTION_PROTOCOL_IP_2_0),
+			D_AUDIO_AS_GENERAL(AUDIO_SPEAKER_IT_ID, AUDIO_SPEAKER_CHANNELS, 0x00000003),
+			D_AUDIO_FORMAT_TYPE_I(AUDIO_SUBSLOT_SIZE, 16),
+			D_ENDPOINT(USB_ENDPOINT_OUT(AUDIO_SPEAKER_EP), USB_ENDPOINT_TYPE_ISOCHRONOUS | USB_ENDPOINT_SYNC_ASYNCHRONOUS, AUDIO_SPEAKER_PACKET_SIZE, interval),
+			D_AUDIO_EP_GENERAL()
+		},
+		D_ENDPOINT(USB_ENDPOINT_IN(AUDIO_FEEDBACK_EP), USB_ENDPOINT_TYPE_ISOCHRONOUS | USB_ENDPOINT_USAGE_FEEDBACK, USBD_IsHighSpeed() ? 4 : 3, interval),
+
+		{
+			D_INTERFACE_ALT(AUDIO_MIC_INTERFACE, 0, 0, AUDIO_FUNCTION_CLASS, AUDIO_SUBCLASS_AUDIOSTREAMING, AUDIO_FUNCTION_PROTOCOL_IP_2_0),
+			D_INTERFACE_ALT(AUDIO_MIC_INTERFACE, 1, 1, AUDIO_FUNCTION_CLASS, AUDIO_SUBCLASS_AUDIOSTREAMING, AUDIO_FUNCTION_PROTOCOL_IP_2_0),
+			D_AUDIO_AS_GENERAL(AUDIO_MIC_OT_ID, AUDIO_MIC_CHANNELS, 0x00000004),
+			D_AUDIO_FORMAT_TYPE_I(AUDIO_SUBSLOT_SIZE, 16),
+			D_ENDPOINT(USB_ENDPOINT_IN(AUDIO_MIC_EP), USB_ENDPOINT_TYPE_ISOCHRONOUS | USB_ENDPOINT_SYNC_ASYNCHRONOUS, AUDIO_MIC_PACKET_SIZE, interval),
+			D_AUDIO_EP_GENERAL()
+		}
+	};
+	return USBD_SendControl(0, &audioInterface, sizeof(audioInterface));
+}
+
+int USBAudio_::getDescriptor(USBSetup& setup __attribute__((unused)))
+{
+	// All class specific descriptors are part of the configuration
+	return 0;
+}
+
+uint8_t USBAudio_::getShortName(char *name)
+{
+	name[0] = 'A';
+	name[1] = 'U';
+	name[2] = 'D';
+	return 3;
+}
+
+bool USBAudio_::setup(USBSetup& setup)
+{
+	// wIndex holds the interface in its low byte, for requests to
+	// entities of the control interface the entity ID in its high byte
+	uint8_t interface = setup.wIndex & 0xFF;
+	if (interface < pluggedInterface || interface >= pluggedInterface + numInterfaces) {
+		return false;
+	}
+
+	uint8_t request = setup.bRequest;
+	uint8_t requestType = setup.bmRequestType;
+
+	if (requestType == (REQUEST_HOSTTODEVICE | REQUEST_STANDARD | REQUEST_INTERFACE))
+	{
+		if (request == SET_INTERFACE) {
+			setAlternate(interface, setup.wValueL);
+			return true;
+		}
+		return false;
+	}
+
+	if (interface == pluggedInterface && (setup.wIndex >> 8) == AUDIO_CLOCK_ID) {
+		return clockRequest(setup);
+	}
+
+	return false;
+}
+
+bool USBAudio_::clockRequest(USBSetup& setup)
+{
+	uint8_t request = setup.bRequest;
+	uint8_t control = setup.wValueH;
+
+	if (setup.bmRequestType == REQUEST_DEVICETOHOST_CLASS_INTERFACE)
+	{
+		// The clock is announced at its nominal rate, the difference to
+		// the rate the converters really run at is made up by feedback
+		if (control == AUDIO_CS_SAM_FREQ_CONTROL && request == AUDIO_REQUEST_CUR) {
+			uint32_t frequency = USBAUDIO_SAMPLE_RATE;
+			USBD_SendControl(0, &frequency, sizeof(frequency));
+			return true;
+		}
+		if (control == AUDIO_CS_SAM_FREQ_CONTROL && request == AUDIO_REQUEST_RANGE) {
+			struct {
+				uint16_t numSubRanges;
+				uint32_t min;
+				uint32_t max;
+				uint32_t res;
+			} __attribute__((packed)) range = { 1, USBAUDIO_SAMPLE_RATE, USBAUDIO_SAMPLE_RATE, 0 };
+			USBD_SendControl(0, &range, sizeof(range));
+			return true;
+		}
+		if (control == AUDIO_CS_CLOCK_VALID_CONTROL && request == AUDIO_REQUEST_CUR) {
+			uint8_t valid = 1;
+			USBD_SendControl(0, &valid, sizeof(valid));
+			return true;
+		}
+	}
+
+	if (setup.bmRequestType == REQUEST_HOSTTODEVICE_CLASS_INTERFACE)
+	{
+		// Fixed clock, only accept what we already run at
+		if (control == AUDIO_CS_SAM_FREQ_CONTROL && request == AUDIO_REQUEST_CUR) {
+			uint32_t frequency = 0;
+			USBD_RecvControl(&frequency, sizeof(frequency));
+			return frequency == USBAUDIO_SAMPLE_RATE;
+		}
+	}
+
+	return false;
+}
+
+void USBAudio_::setAlternate(uint8_t interface, uint8_t alt)
+{
+	if (interface == AUDIO_SPEAKER_INTERFACE) {
+		// Start from an empty ring, the DACC plays silence until the
+		// first block is complete
+		dacHead = dacTail;
+		speakerAlt = alt;
+	} else if (interface == AUDIO_MIC_INTERFACE) {
+		adcTail = adcHead;
+		micRemainder = 0;
+		micAlt = alt;
+	}
+	updateSOF();
+}
+
+void USBAudio_::updateSOF(void)
+{
+	// Streaming is paced by the start of frame interrupt, which is only
+	// needed while one of the streaming interfaces is operational
+	if (speakerAlt || micAlt)
+		USBD_EnableSOF(false);
+	else
+		USBD_DisableSOF();
+}
+
+void USBAudio_::handleSOF(uint32_t frameNumber __attribute__((unused)))
+{
+	if (speakerAlt) {
+		receiveSpeaker();
+		sendFeedback();
+	}
+	if (micAlt) {
+		sendMic();
+	}
+}
+
+void USBAudio_::receiveSpeaker(void)
+{
+	int16_t packet[AUDIO_SPEAKER_PACKET_SIZE / 2];
+	uint32_t len = USBD_RecvIso(AUDIO_SPEAKER_EP, packet, sizeof(packet));
+	if (len == (uint32_t)-1)
+		return;
+
+	// Two blocks may still be read by the PDC behind dacTail
+	uint32_t head = dacHead;
+	uint32_t space = DAC_RING_SIZE - 2 * DAC_BLOCK_SIZE - (head - dacTail);
+	uint32_t n = min(len / 2, space) & ~1UL;
+
+	for (uint32_t i = 0; i < n; i += 2) {
+		dacRing[(head + i) & (DAC_RING_SIZE - 1)] = (uint16_t)(packet[i] + 32768) >> 4;
+		dacRing[(head + i + 1) & (DAC_RING_SIZE - 1)] = ((uint16_t)(packet[i + 1] + 32768) >> 4) | DACC_CDR_TAG_CH1;
+	}
+	dacHead = head + n;
+}
+
+void USBAudio_::sendFeedback(void)
+{
+	// Samples per millisecond in 16.16, corrected by how far the ring is
+	// from being half full so the host speeds up or slows down
+	const int32_t target = (DAC_RING_SIZE - 2 * DAC_BLOCK_SIZE) / 2;
+	int32_t error = target - (int32_t)(dacHead - dacTail);
+	error = constrain(error, -64, 64);
+	uint32_t feedback = (((uint64_t)rate << 16) / 1000) + (error << 9);
+
+	if (USBD_IsHighSpeed()) {
+		// 16.16 samples per microframe
+		feedback >>= 3;
+		USBD_SendIso(AUDIO_FEEDBACK_EP, &feedback, 4);
+	} else {
+		// 10.14 samples per frame, 3 bytes
+		feedback >>= 2;
+		USBD_SendIso(AUDIO_FEEDBACK_EP, &feedback, 3);
+	}
+}
+
+void USBAudio_::sendMic(void)
+{
+	int16_t packet[AUDIO_MIC_PACKET_SIZE / 2];
+
+	// Nominal number of samples for this millisecond
+	micRemainder += rate;
+	uint32_t n = micRemainder / 1000;
+	micRemainder %= 1000;
+
+	uint32_t head = adcHead;
+	uint32_t avail = head - adcTail;
+	if (avail > ADC_RING_SIZE - 2 * ADC_BLOCK_SIZE) {
+		// Overrun, the PDC already wrote over the oldest samples
+		adcTail = head - (ADC_RING_SIZE - 2 * ADC_BLOCK_SIZE);
+		avail = ADC_RING_SIZE - 2 * ADC_BLOCK_SIZE;
+	}
+	// Asynchronous endpoint, drain a growing backlog one sample at a time
+	if (avail > n + 2 * ADC_BLOCK_SIZE && n < sizeof(packet) / 2)
+		n++;
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (i < avail)
+			adcLast = adcRing[(adcTail + i) & (ADC_RING_SIZE - 1)] & 0xFFF;
+		packet[i] = (int16_t)((adcLast - 0x800) << 4);
+	}
+	adcTail += min(n, avail);
+
+	USBD_SendIso(AUDIO_MIC_EP, packet, n * 2);
+}
+
+static void USBAudio_DACCHandler(void)
+{
+	USBAudio.handleDACC();
+}
+
+static void USBAudio_ADCHandler(void)
+{
+	USBAudio.handleADC();
+}
+
+static uint32_t startTrigger(uint32_t channel, uint32_t rc)
+{
+	pmc_enable_periph_clk(ID_TC0 + channel);
+	// TIOA rises on RC compare, that edge triggers the converter
+	TC_Configure(TC0, channel, TC_CMR_TCCLKS_TIMER_CLOCK1 | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC |
+		TC_CMR_ACPA_CLEAR | TC_CMR_ACPC_SET);
+	TC_SetRC(TC0, channel, rc);
+	TC_SetRA(TC0, channel, rc / 2);
+	return rc;
+}
+
+int USBAudio_::begin(uint32_t micPin)
+{
+	if (micPin < A0)
+		micPin += A0;
+	if (g_APinDescription[micPin].ulAnalogChannel == NO_ADC)
+		return -1;
+	micChannel = g_APinDescription[micPin].ulADCChannelNumber;
+
+	end();
+
+	// TIOA1 paces the DACC at twice the rate (left, right), TIOA2 the ADC.
+	// Both come from the same divider so they can not drift apart.
+	uint32_t rc = ((VARIANT_MCK / 2) + USBAUDIO_SAMPLE_RATE) / (2 * USBAUDIO_SAMPLE_RATE);
+	startTrigger(1, rc);
+	startTrigger(2, 2 * rc);
+	rate = (VARIANT_MCK / 2) / (2 * rc);
+
+	// DACC in tag mode, the channel is taken from bits 12-13 of each sample
+	for (uint32_t i = 0; i < DAC_BLOCK_SIZE; i += 2) {
+		dacSilence[i] = 0x800;
+		dacSilence[i + 1] = 0x800 | DACC_CDR_TAG_CH1;
+	}
+	dacHead = dacTail = 0;
+
+	pmc_enable_periph_clk(DACC_INTERFACE_ID);
+	dacc_reset(DACC_INTERFACE);
+	dacc_set_transfer_mode(DACC_INTERFACE, 0);
+	dacc_set_power_save(DACC_INTERFACE, 0, 0);
+	dacc_set_timing(DACC_INTERFACE, 0x08, 0, 0x10);
+	dacc_set_analog_control(DACC_INTERFACE, DACC_ACR_IBCTLCH0(0x02) |
+								DACC_ACR_IBCTLCH1(0x02) |
+								DACC_ACR_IBCTLDACCORE(0x01));
+	dacc_enable_flexible_selection(DACC_INTERFACE);
+	dacc_enable_channel(DACC_INTERFACE, 0);
+	dacc_enable_channel(DACC_INTERFACE, 1);
+	dacc_set_trigger(DACC_INTERFACE, 2);
+
+	DACC_INTERFACE->DACC_TPR = (uint32_t)dacSilence;
+	DACC_INTERFACE->DACC_TCR = DAC_BLOCK_SIZE;
+	DACC_INTERFACE->DACC_TNPR = (uint32_t)dacSilence;
+	DACC_INTERFACE->DACC_TNCR = DAC_BLOCK_SIZE;
+	DACC_INTERFACE->DACC_PTCR = PERIPH_PTCR_TXTEN;
+	dacAttachInterrupt(USBAudio_DACCHandler);
+	dacc_enable_interrupt(DACC_INTERFACE, DACC_IER_ENDTX);
+
+	// ADC converts the microphone channel on every TIOA2 rising edge
+	adcHead = adcTail = 0;
+	adcNext = 2 * ADC_BLOCK_SIZE;
+
+	adc_disable_all_channel(ADC);
+	adc_enable_channel(ADC, (adc_channel_num_t)micChannel);
+	adc_configure_trigger(ADC, ADC_TRIG_TIO_CH_2, 0);
+
+	ADC->ADC_RPR = (uint32_t)&adcRing[0];
+	ADC->ADC_RCR = ADC_BLOCK_SIZE;
+	ADC->ADC_RNPR = (uint32_t)&adcRing[ADC_BLOCK_SIZE];
+	ADC->ADC_RNCR = ADC_BLOCK_SIZE;
+	ADC->ADC_PTCR = PERIPH_PTCR_RXTEN;
+	adcAttachInterrupt(USBAudio_ADCHandler);
+	adc_enable_interrupt(ADC, ADC_IER_ENDRX);
+
+	TC_Start(TC0, 1);
+	TC_Start(TC0, 2);
+	started = true;
+	return 0;
+}
+
+void USBAudio_::end(void)
+{
+	if (!started)
+		return;
+	started = false;
+
+	TC_Stop(TC0, 1);
+	TC_Stop(TC0, 2);
+
+	dacDetachInterrupt();
+	DACC_INTERFACE->DACC_PTCR = PERIPH_PTCR_TXTDIS;
+	dacc_disable_trigger(DACC_INTERFACE);
+	dacc_disable_channel(DACC_INTERFACE, 0);
+	dacc_disable_channel(DACC_INTERFACE, 1);
+
+	// Give the ADC back to analogRead()
+	adcDetachInterrupt();
+	ADC->ADC_PTCR = PERIPH_PTCR_RXTDIS;
+	adc_configure_trigger(ADC, ADC_TRIG_SW, 0);
+	adc_disable_channel(ADC, (adc_channel_num_t)micChannel);
+}
+
+void USBAudio_::handleDACC(void)
+{
+	if ((dacc_get_interrupt_status(DACC_INTERFACE) & DACC_ISR_ENDTX) == 0)
+		return;
+
+	// Queue the next complete block, or silence on underrun
+	uint32_t tail = dacTail;
+	if (dacHead - tail >= DAC_BLOCK_SIZE) {
+		DACC_INTERFACE->DACC_TNPR = (uint32_t)&dacRing[tail & (DAC_RING_SIZE - 1)];
+		dacTail = tail + DAC_BLOCK_SIZE;
+	} else {
+		DACC_INTERFACE->DACC_TNPR = (uint32_t)dacSilence;
+	}
+	DACC_INTERFACE->DACC_TNCR = DAC_BLOCK_SIZE;
+}
+
+void USBAudio_::handleADC(void)
+{
+	if ((adc_get_status(ADC) & ADC_ISR_ENDRX) == 0)
+		return;
+
+	// One block is complete, the PDC continues with the next one
+	adcHead += ADC_BLOCK_SIZE;
+	ADC->ADC_RNPR = (uint32_t)&adcRing[adcNext & (ADC_RING_SIZE - 1)];
+	ADC->ADC_RNCR = ADC_BLOCK_SIZE;
+	adcNext += ADC_BLOCK_SIZE;
+}
+
+#endif /* if defined(USBCON) */
@@ -0,0 +1,273 @@
+/*
+  Copyright (c) 2015, Arduino LLC
+
+  Permission to use, copy, modify, and/or distribute this software for
+  any purpose with or without fee is hereby granted, provided that the
+  above copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+  WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+  BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+  OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+  WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+  ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+  SOFTWARE.
+ */
+
+#ifndef USBAudio_h
+#define USBAudio_h
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "USB/PluggableUSB.h"
+
+#if defined(USBCON)
+
+#define _USING_USBAUDIO
+
+// Nominal sample rate of both streams. The DACC and the ADC are paced by
+// TC0 channels 1 and 2, so the real rate is the nearest MCK/2 divisor;
+// the host is told about the difference through the feedback endpoint.
+#ifndef USBAUDIO_SAMPLE_RATE
+#define USBAUDIO_SAMPLE_RATE 48000
+#endif
+
+// USB Audio Class 2.0 'Driver'
+// ----------------------------
+#define AUDIO_FUNCTION_CLASS                 0x01
+#define AUDIO_FUNCTION_PROTOCOL_IP_2_0       0x20
+
+#define AUDIO_SUBCLASS_AUDIOCONTROL          0x01
+#define AUDIO_SUBCLASS_AUDIOSTREAMING        0x02
+
+#define AUDIO_CS_INTERFACE                   0x24
+#define AUDIO_CS_ENDPOINT                    0x25
+
+#define AUDIO_AC_HEADER                      0x01
+#define AUDIO_AC_INPUT_TERMINAL              0x02
+#define AUDIO_AC_OUTPUT_TERMINAL             0x03
+#define AUDIO_AC_CLOCK_SOURCE                0x0A
+
+#define AUDIO_AS_GENERAL                     0x01
+#define AUDIO_AS_FORMAT_TYPE                 0x02
+#define AUDIO_EP_GENERAL                     0x01
+
+#define AUDIO_FORMAT_TYPE_I                  0x01
+#define AUDIO_FORMAT_PCM                     0x00000001
+
+#define AUDIO_CATEGORY_IO_BOX                0x08
+
+#define AUDIO_TERMINAL_USB_STREAMING         0x0101
+#define AUDIO_TERMINAL_MICROPHONE            0x0201
+#define AUDIO_TERMINAL_SPEAKER               0x0301
+
+// Class specific requests and clock source control selectors
+#define AUDIO_REQUEST_CUR                    0x01
+#define AUDIO_REQUEST_RANGE                  0x02
+
+#define AUDIO_CS_SAM_FREQ_CONTROL            0x01
+#define AUDIO_CS_CLOCK_VALID_CONTROL         0x02
+
+// Entity IDs of the audio function topology
+#define AUDIO_CLOCK_ID                       1
+#define AUDIO_SPEAKER_IT_ID                  2
+#define AUDIO_SPEAKER_OT_ID                  3
+#define AUDIO_MIC_IT_ID                      4
+#define AUDIO_MIC_OT_ID                      5
+
+#define AUDIO_SPEAKER_CHANNELS               2
+#define AUDIO_MIC_CHANNELS                   1
+#define AUDIO_SUBSLOT_SIZE                   2
+
+// One packet per millisecond, one extra sample for rate matching
+#define AUDIO_SPEAKER_PACKET_SIZE  ((USBAUDIO_SAMPLE_RATE/1000+1)*AUDIO_SPEAKER_CHANNELS*AUDIO_SUBSLOT_SIZE)
+#define AUDIO_MIC_PACKET_SIZE      ((USBAUDIO_SAMPLE_RATE/1000+1)*AUDIO_MIC_CHANNELS*AUDIO_SUBSLOT_SIZE)
+
+typedef struct
+{
+  uint8_t  len;         // 9
+  uint8_t  dtype;       // 0x24
+  uint8_t  subtype;     // 0x01
+  uint16_t bcdADC;      // 0x0200
+  uint8_t  category;
+  uint16_t totalLength;
+  uint8_t  controls;
+} __attribute__((packed)) AudioACHeaderDescriptor;
+
+typedef struct
+{
+  uint8_t  len;         // 8
+  uint8_t  dtype;       // 0x24
+  uint8_t  subtype;     // 0x0A
+  uint8_t  clockID;
+  uint8_t  attributes;
+  uint8_t  controls;
+  uint8_t  assocTerminal;
+  uint8_t  iClockSource;
+} __attribute__((packed)) AudioClockSourceDescriptor;
+
+typedef struct
+{
+  uint8_t  len;         // 17
+  uint8_t  dtype;       // 0x24
+  uint8_t  subtype;     // 0x02
+  uint8_t  terminalID;
+  uint16_t terminalType;
+  uint8_t  assocTerminal;
+  uint8_t  clockSourceID;
+  uint8_t  numChannels;
+  uint32_t channelConfig;
+  uint8_t  iChannelNames;
+  uint16_t controls;
+  uint8_t  iTerminal;
+} __attribute__((packed)) AudioInputTerminalDescriptor;
+
+typedef struct
+{
+  uint8_t  len;         // 12
+  uint8_t  dtype;       // 0x24
+  uint8_t  subtype;     // 0x03
+  uint8_t  terminalID;
+  uint16_t terminalType;
+  uint8_t  assocTerminal;
+  uint8_t  sourceID;
+  uint8_t  clockSourceID;
+  uint16_t controls;
+  uint8_t  iTerminal;
+} __attribute__((packed)) AudioOutputTerminalDescriptor;
+
+typedef struct
+{
+  uint8_t  len;         // 16
+  uint8_t  dtype;       // 0x24
+  uint8_t  subtype;     // 0x01
+  uint8_t  terminalLink;
+  uint8_t  controls;
+  uint8_t  formatType;
+  uint32_t formats;
+  uint8_t  numChannels;
+  uint32_t channelConfig;
+  uint8_t  iChannelNames;
+} __attribute__((packed)) AudioASGeneralDescriptor;
+
+typedef struct
+{
+  uint8_t  len;         // 6
+  uint8_t  dtype;       // 0x24
+  uint8_t  subtype;     // 0x02
+  uint8_t  formatType;
+  uint8_t  subslotSize;
+  uint8_t  bitResolution;
+} __attribute__((packed)) AudioFormatTypeIDescriptor;
+
+typedef struct
+{
+  uint8_t  len;         // 8
+  uint8_t  dtype;       // 0x25
+  uint8_t  subtype;     // 0x01
+  uint8_t  attributes;
+  uint8_t  controls;
+  uint8_t  lockDelayUnits;
+  uint16_t lockDelay;
+} __attribute__((packed)) AudioEndpointDescriptor;
+
+typedef struct
+{
+  InterfaceDescriptor           alt0;
+  InterfaceDescriptor           alt1;
+  AudioASGeneralDescriptor      general;
+  AudioFormatTypeIDescriptor    format;
+  EndpointDescriptor            data;
+  AudioEndpointDescriptor       csData;
+} __attribute__((packed)) AudioStreamingDescriptor;
+
+typedef struct
+{
+  IADDescriptor                 iad;
+
+  // Control
+  InterfaceDescriptor           control;
+  AudioACHeaderDescriptor       header;
+  AudioClockSourceDescriptor    clock;
+  AudioInputTerminalDescriptor  speakerIn;
+  AudioOutputTerminalDescriptor speakerOut;
+  AudioInputTerminalDescriptor  micIn;
+  AudioOutputTerminalDescriptor micOut;
+
+  // Speaker (host to DACC), asynchronous with explicit feedback
+  AudioStreamingDescriptor      speaker;
+  EndpointDescriptor            feedback;
+
+  // Microphone (ADC to host)
+  AudioStreamingDescriptor      mic;
+} __attribute__((packed)) AudioDescriptor;
+
+#define D_AUDIO_AC_HEADER(_category,_totalLength) \
+	{ 9, AUDIO_CS_INTERFACE, AUDIO_AC_HEADER, 0x0200, _category, _totalLength, 0 }
+#define D_AUDIO_CLOCK_SOURCE(_id,_attributes,_controls) \
+	{ 8, AUDIO_CS_INTERFACE, AUDIO_AC_CLOCK_SOURCE, _id, _attributes, _controls, 0, 0 }
+#define D_AUDIO_INPUT_TERMINAL(_id,_type,_clock,_channels,_config) \
+	{ 17, AUDIO_CS_INTERFACE, AUDIO_AC_INPUT_TERMINAL, _id, _type, 0, _clock, _channels, _config, 0, 0, 0 }
+#define D_AUDIO_OUTPUT_TERMINAL(_id,_type,_source,_clock) \
+	{ 12, AUDIO_CS_INTERFACE, AUDIO_AC_OUTPUT_TERMINAL, _id, _type, 0, _source, _clock, 0, 0 }
+#define D_AUDIO_AS_GENERAL(_link,_channels,_config) \
+	{ 16, AUDIO_CS_INTERFACE, AUDIO_AS_GENERAL, _link, 0, AUDIO_FORMAT_TYPE_I, AUDIO_FORMAT_PCM, _channels, _config, 0 }
+#define D_AUDIO_FORMAT_TYPE_I(_subslot,_bits) \
+	{ 6, AUDIO_CS_INTERFACE, AUDIO_AS_FORMAT_TYPE, AUDIO_FORMAT_TYPE_I, _subslot, _bits }
+#define D_AUDIO_EP_GENERAL() \
+	{ 8, AUDIO_CS_ENDPOINT, AUDIO_EP_GENERAL, 0, 0, 0, 0 }
+
+class USBAudio_ : public PluggableUSBModule
+{
+public:
+  USBAudio_(void);
+
+  // Start the timers, DACC and ADC. Streams only run while the host has
+  // selected the operational alternate setting of the interface; while
+  // the microphone streams, analogRead() must not be used.
+  int begin(uint32_t micPin = A0);
+  void end(void);
+
+  // Rate the DACC and the ADC actually run at
+  uint32_t sampleRate(void) { return rate; }
+
+  bool speakerActive(void) { return speakerAlt != 0; }
+  bool micActive(void) { return micAlt != 0; }
+
+  // Called from the DACC and ADC interrupt handlers
+  void handleDACC(void);
+  void handleADC(void);
+
+protected:
+  // Implementation of the PluggableUSBModule
+  int getInterface(uint8_t* interfaceCount);
+  int getDescriptor(USBSetup& setup);
+  bool setup(USBSetup& setup);
+  uint8_t getShortName(char* name);
+  void handleSOF(uint32_t frameNumber);
+
+private:
+  bool clockRequest(USBSetup& setup);
+  void setAlternate(uint8_t interface, uint8_t alt);
+  void updateSOF(void);
+  void receiveSpeaker(void);
+  void sendFeedback(void);
+  void sendMic(void);
+
+  uint32_t epType[3];
+
+  uint32_t rate;
+  uint32_t micChannel;
+  uint32_t micRemainder;
+
+  bool started;
+  uint8_t speakerAlt;
+  uint8_t micAlt;
+};
+
+extern USBAudio_ USBAudio;
+
+#endif // USBCON
+
+#endif // USBAudio_h
@@ -96,6 +96,21 @@
 									UOTGHS_DEVEPTCFG_NBTRANS_3_TRANS |   \
 									UOTGHS_DEVEPTCFG_ALLOC)
 
+// Isochronous Endpoints, one transaction per (micro)frame on two banks
+// (ping-pong) so that they fit in DPRAM next to the CDC endpoints
+#define EP_TYPE_ISOCHRONOUS_IN_PINGPONG		(UOTGHS_DEVEPTCFG_EPSIZE_512_BYTE | \
+									UOTGHS_DEVEPTCFG_EPDIR_IN |          \
+									UOTGHS_DEVEPTCFG_EPTYPE_ISO |        \
+									UOTGHS_DEVEPTCFG_EPBK_2_BANK |       \
+									UOTGHS_DEVEPTCFG_NBTRANS_1_TRANS |   \
+									UOTGHS_DEVEPTCFG_ALLOC)
+
+#define EP_TYPE_ISOCHRONOUS_OUT_PINGPONG	(UOTGHS_DEVEPTCFG_EPSIZE_512_BYTE | \
+									UOTGHS_DEVEPTCFG_EPTYPE_ISO |        \
+									UOTGHS_DEVEPTCFG_EPBK_2_BANK |       \
+									UOTGHS_DEVEPTCFG_NBTRANS_1_TRANS |   \
+									UOTGHS_DEVEPTCFG_ALLOC)
+
 //! \ingroup usb_device_group
 //! \defgroup udd_group USB Device Driver (UDD)
 //! UOTGHS low-level driver for USB device mode